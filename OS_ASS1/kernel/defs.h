@@ -1,9 +1,12 @@
 struct buf;
 struct context;
 struct file;
+struct kmem_cache;
 struct inode;
 struct pipe;
 struct proc;
+struct runheap;
+struct runlist;
 struct spinlock;
 struct sleeplock;
 struct stat;
@@ -25,6 +28,12 @@ void            consputc(int);
 // exec.c
 int             exec(char*, char**);
 
+// slab.c
+struct kmem_cache* kmem_cache_create(char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+void            kmem_cache_dump(void);
+
 // file.c
 struct file*    filealloc(void);
 void            fileclose(struct file*);
@@ -63,6 +72,10 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kalloc_order(int);
+void            kfree_order(void *, int);
+void            kalloc_test(void);
+void            kmemdump(void);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -72,6 +85,7 @@ void            end_op(void);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
+void            pipeinit(void);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
@@ -105,15 +119,39 @@ int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 int             pause_system(int);
+void            pause_tick(void);
 int             kill_system(void);
 void            print_stats(void);
 int             should_run_process(struct proc* p);
 void            set_cpu_ticks(struct proc *p);
-void            run_process(struct proc *p, struct cpu *c);
-void            rr_sched(void) __attribute__((noreturn));
-void            sjf_sched(void) __attribute__((noreturn));
-void            fcfs_sched(void) __attribute__((noreturn));
-
+int             run_process(struct proc *p, struct cpu *c);
+int             rr_sched(struct cpu *c);
+int             sjf_sched(struct cpu *c);
+int             fcfs_sched(struct cpu *c);
+int             mlfq_sched(struct cpu *c);
+int             cfs_sched(struct cpu *c);
+int             stride_sched(struct cpu *c);
+int             getprocstats(int, uint64);
+int             getsysstats(uint64);
+int             getschedhist(int, uint64);
+int             setnice(int, int);
+int             settickets(int, int);
+int             getnice(int);
+int             set_policy(int);
+int             get_policy(void);
+void            rq_add(struct proc *p);
+void            rq_remove(struct proc *p);
+int             should_preempt(void);
+
+
+// runq.c
+void            heap_push(struct runheap*, struct proc*);
+struct proc*    heap_min(struct runheap*);
+struct proc*    heap_pop(struct runheap*);
+void            heap_remove(struct runheap*, struct proc*);
+void            list_push(struct runlist*, struct proc*);
+struct proc*    list_pop(struct runlist*);
+void            list_remove(struct runlist*, struct proc*);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -132,6 +170,10 @@ void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
+// start.c
+int             timer_fired(void);
+void            wakeup_hart(int);
+
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
@@ -1,6 +1,7 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or with kalloc_order() blocks of 2^n contiguous pages.
 
 #include "types.h"
 #include "param.h"
@@ -14,19 +15,50 @@ void freerange(void *pa_start, void *pa_end);
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
+// Index of the page at pa among all of RAM, and the number of pages.
+#define PGIDX(pa) (((uint64)(pa) - KERNBASE) >> PGSHIFT)
+#define NPAGE     ((PHYSTOP - KERNBASE) >> PGSHIFT)
+
 struct run {
   struct run *next;
+  struct run *prev;   // Only on the buddy free lists
 };
 
+// A binary buddy allocator. A free block of order n is 2^n pages,
+// aligned to its size, and sits on freelist[n]. Freeing a block
+// whose buddy, the other half of the block twice its size, is free
+// too merges them, as far up as MAXORDER.
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run *freelist[MAXORDER+1];
+  int nblocks[MAXORDER+1];
+  int nfree;          // Free pages in all of the blocks
+  uchar head[NPAGE];  // 1 + order of the free block at each page, or 0
 } kmem;
 
+// A CPU's cache of free pages. kalloc() and kfree() work on the
+// running CPU's cache, and move KBATCH pages at a time to or from
+// kmem when it runs empty or grows past KCACHE. A CPU that finds
+// both its cache and kmem empty steals half of another CPU's
+// cache, so no free page is stranded in an idle CPU's cache.
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  int nfree;
+  uint64 hits;        // kalloc()s served from the cache
+  uint64 refills;     // batches taken from kmem
+  uint64 steals;      // batches taken from another CPU
+  uint64 drains;      // batches given back to kmem
+} __attribute__((aligned(CACHELINE)));
+
+struct kcache kcaches[NCPU];
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
+  for(struct kcache *kc = kcaches; kc < &kcaches[NCPU]; kc++)
+    initlock(&kc->lock, "kcache");
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -39,6 +71,163 @@ freerange(void *pa_start, void *pa_end)
     kfree(p);
 }
 
+// Unlink up to n pages from the front of *list.
+// Returns them as a list, and their number in *moved.
+static struct run*
+kcut(struct run **list, int n, int *moved)
+{
+  struct run *head = *list, *r = 0;
+  int i;
+
+  for(i = 0; i < n && *list; i++){
+    r = *list;
+    *list = r->next;
+  }
+  if(r)
+    r->next = 0;
+  *moved = i;
+  return i ? head : 0;
+}
+
+static void
+buddy_push(struct run *r, int order)
+{
+  r->prev = 0;
+  r->next = kmem.freelist[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.freelist[order] = r;
+  kmem.nblocks[order]++;
+  kmem.head[PGIDX(r)] = order + 1;
+}
+
+static void
+buddy_unlink(struct run *r, int order)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.freelist[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nblocks[order]--;
+  kmem.head[PGIDX(r)] = 0;
+}
+
+// Take a block of the given order, splitting a larger one if
+// need be. Caller must hold kmem.lock.
+static struct run*
+buddy_alloc(int order)
+{
+  struct run *r;
+  int o;
+
+  for(o = order; o <= MAXORDER && kmem.freelist[o] == 0; o++)
+    ;
+  if(o > MAXORDER)
+    return 0;
+  r = kmem.freelist[o];
+  buddy_unlink(r, o);
+  // give back the upper half until the block is small enough.
+  while(o > order){
+    o--;
+    buddy_push((struct run*)((char*)r + (PGSIZE << o)), o);
+  }
+  kmem.nfree -= 1 << order;
+  return r;
+}
+
+// Free a block of the given order, merging it with its buddy
+// for as long as the buddy is free. Caller must hold kmem.lock.
+static void
+buddy_free(struct run *r, int order)
+{
+  uint64 i = PGIDX(r), b;
+
+  kmem.nfree += 1 << order;
+  for(; order < MAXORDER; order++){
+    b = i ^ (1 << order);
+    if(b >= NPAGE || kmem.head[b] != order + 1)
+      break;
+    buddy_unlink((struct run*)(KERNBASE + (b << PGSHIFT)), order);
+    i &= ~(uint64)(1 << order);
+  }
+  buddy_push((struct run*)(KERNBASE + (i << PGSHIFT)), order);
+}
+
+// Give every page in the CPU caches back to the buddy allocator,
+// so that it can merge them into larger blocks.
+// Returns the number of pages given back.
+static int
+kdrain(void)
+{
+  struct kcache *kc;
+  struct run *batch, *next;
+  int n, total = 0;
+
+  for(kc = kcaches; kc < &kcaches[NCPU]; kc++){
+    acquire(&kc->lock);
+    batch = kcut(&kc->freelist, kc->nfree, &n);
+    kc->nfree -= n;
+    release(&kc->lock);
+    acquire(&kmem.lock);
+    for(; batch; batch = next){
+      next = batch->next;
+      buddy_free(batch, 0);
+    }
+    release(&kmem.lock);
+    total += n;
+  }
+  return total;
+}
+
+// Get pages for kc, whose cache is empty: a batch from kmem, or
+// failing that half of another CPU's cache. Keeps the rest in kc
+// and returns one page, or 0 if there is no free memory at all.
+// Takes one cache lock at a time, so CPUs stealing from each
+// other cannot deadlock.
+static struct run*
+krefill(struct kcache *kc)
+{
+  struct kcache *victim;
+  struct run *batch = 0, *last, *r;
+  int n, stolen = 0;
+
+  acquire(&kmem.lock);
+  for(n = 0; n < KBATCH && (r = buddy_alloc(0)) != 0; n++){
+    r->next = batch;
+    batch = r;
+  }
+  release(&kmem.lock);
+
+  for(victim = kcaches; batch == 0 && victim < &kcaches[NCPU]; victim++){
+    if(victim == kc || victim->nfree == 0)
+      continue;
+    acquire(&victim->lock);
+    batch = kcut(&victim->freelist, (victim->nfree + 1) / 2, &n);
+    victim->nfree -= n;
+    release(&victim->lock);
+    stolen = 1;
+  }
+  if(batch == 0)
+    return 0;
+
+  acquire(&kc->lock);
+  if(stolen)
+    kc->steals++;
+  else
+    kc->refills++;
+  if(batch->next){
+    for(last = batch->next; last->next; last = last->next)
+      ;
+    last->next = kc->freelist;
+    kc->freelist = batch->next;
+    kc->nfree += n - 1;
+  }
+  release(&kc->lock);
+  return batch;
+}
+
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
 // call to kalloc().  (The exception is when
@@ -46,7 +235,9 @@ freerange(void *pa_start, void *pa_end)
 void
 kfree(void *pa)
 {
-  struct run *r;
+  struct kcache *kc;
+  struct run *r, *batch = 0, *next;
+  int n;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
@@ -56,10 +247,27 @@ kfree(void *pa)
 
   r = (struct run*)pa;
 
-  acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  release(&kmem.lock);
+  push_off();
+  kc = &kcaches[cpuid()];
+  acquire(&kc->lock);
+  r->next = kc->freelist;
+  kc->freelist = r;
+  if(++kc->nfree > KCACHE){
+    batch = kcut(&kc->freelist, KBATCH, &n);
+    kc->nfree -= n;
+    kc->drains++;
+  }
+  release(&kc->lock);
+  pop_off();
+
+  if(batch){
+    acquire(&kmem.lock);
+    for(; batch; batch = next){
+      next = batch->next;
+      buddy_free(batch, 0);
+    }
+    release(&kmem.lock);
+  }
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -68,15 +276,173 @@ kfree(void *pa)
 void *
 kalloc(void)
 {
+  struct kcache *kc;
   struct run *r;
 
+  push_off();
+  kc = &kcaches[cpuid()];
+  acquire(&kc->lock);
+  r = kc->freelist;
+  if(r){
+    kc->freelist = r->next;
+    kc->nfree--;
+    kc->hits++;
+  }
+  release(&kc->lock);
+  if(r == 0)
+    r = krefill(kc);
+  pop_off();
+
+  if(r){
+    memset((char*)r, 5, PGSIZE); // fill with junk
+  }
+  return (void*)r;
+}
+
+// Allocate 2^order physically contiguous pages, aligned to their
+// size. Returns 0 if no block that large can be found, even after
+// taking back the pages cached by the CPUs.
+void *
+kalloc_order(int order)
+{
+  struct run *r;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  r = buddy_alloc(order);
   release(&kmem.lock);
+  if(r == 0 && kdrain() > 0){
+    acquire(&kmem.lock);
+    r = buddy_alloc(order);
+    release(&kmem.lock);
+  }
 
-  if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+  if(r){
+    memset((char*)r, 5, PGSIZE << order); // fill with junk
+  }
   return (void*)r;
 }
+
+// Free a block that kalloc_order(order) returned.
+void
+kfree_order(void *pa, int order)
+{
+  if(order < 0 || order > MAXORDER || PGIDX(pa) % (1 << order) != 0 ||
+     (char*)pa < end || (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("kfree_order");
+
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, PGSIZE << order);
+
+  acquire(&kmem.lock);
+  buddy_free((struct run*)pa, order);
+  release(&kmem.lock);
+}
+
+// Whether the free lists match a snapshot taken by kalloc_test().
+// Caller must hold kmem.lock.
+static int
+buddy_same(int *nblocks, int nfree)
+{
+  return kmem.nfree == nfree &&
+         memcmp(kmem.nblocks, nblocks, sizeof(kmem.nblocks)) == 0;
+}
+
+// Self-test of the buddy allocator, run once at boot by kernels
+// built with KALLOCTEST=ON, before the other harts start and before
+// there are any processes, so that it may use up all free memory.
+// Splits and merges blocks of mixed orders, checks that the free
+// lists come back as they were, and panics if they do not.
+void
+kalloc_test(void)
+{
+  static int orders[] = { 0, 3, 1, 2, 0, 5, 4, 1 };
+  struct run *blocks[NELEM(orders)], *r, *list = 0;
+  int nblocks[MAXORDER+1], nfree, i, n, back;
+  char *why = 0;
+
+  // hold kmem.lock, so that nothing else moves blocks while the
+  // counts are compared; report failures only after releasing it.
+  acquire(&kmem.lock);
+  memmove(nblocks, kmem.nblocks, sizeof(nblocks));
+  nfree = kmem.nfree;
+
+  // mixed orders, freed in a different order than taken.
+  for(i = 0; i < NELEM(orders); i++){
+    blocks[i] = buddy_alloc(orders[i]);
+    if(blocks[i] == 0 || PGIDX(blocks[i]) % (1 << orders[i]) != 0)
+      why = "bad block of mixed order";
+  }
+  for(n = 1; n >= 0; n--){
+    for(i = n; i < NELEM(orders); i += 2){
+      if(blocks[i])
+        buddy_free(blocks[i], orders[i]);
+    }
+  }
+  if(!why && !buddy_same(nblocks, nfree))
+    why = "mixed orders did not merge back";
+
+  // a whole MAXORDER block freed page by page, every other page
+  // first, so it can merge back into one block only at the end.
+  if((r = buddy_alloc(MAXORDER)) == 0){
+    if(!why)
+      why = "no free block of MAXORDER";
+  } else {
+    for(i = 0; i < 2; i++){
+      for(n = i; n < (1 << MAXORDER); n += 2)
+        buddy_free((struct run*)((char*)r + n * PGSIZE), 0);
+      if(i == 0 && !why && kmem.nblocks[0] != nblocks[0] + (1 << (MAXORDER - 1)))
+        why = "pages merged too early";
+    }
+    if(!why && !buddy_same(nblocks, nfree))
+      why = "split block did not merge back";
+  }
+  release(&kmem.lock);
+  if(why){
+    printf("kalloc_test: %s\n", why);
+    panic("kalloc_test");
+  }
+
+  // every MAXORDER block through kalloc_order(); the attempt that
+  // finds none left empties the CPU caches and tries again.
+  for(n = 0; (r = (struct run*)kalloc_order(MAXORDER)) != 0; n++){
+    r->next = list;
+    list = r;
+  }
+  for(; list; list = r){
+    r = list->next;
+    kfree_order(list, MAXORDER);
+  }
+  acquire(&kmem.lock);
+  back = kmem.nblocks[MAXORDER];
+  release(&kmem.lock);
+  if(n == 0 || back < n){
+    printf("kalloc_test: %d blocks of order %d taken, %d back\n",
+           n, MAXORDER, back);
+    panic("kalloc_test");
+  }
+  printf("kalloc_test: OK, %d blocks of order %d\n", n, MAXORDER);
+}
+
+// Print the free page counts and cache statistics, for procdump(),
+// and how fragmented free memory is: the free blocks of each order.
+// No locks, like procdump().
+void
+kmemdump(void)
+{
+  struct kcache *kc;
+  int o;
+
+  printf("kmem: %d free pages, blocks by order:", kmem.nfree);
+  for(o = 0; o <= MAXORDER; o++)
+    printf(" %d", kmem.nblocks[o]);
+  printf("\n");
+  for(kc = kcaches; kc < &kcaches[NCPU]; kc++){
+    if(kc->hits + kc->refills + kc->steals + kc->drains == 0)
+      continue;
+    printf("cpu %d: page cache %d free, %d hits, %d refills, %d steals, %d drains\n",
+           (int)(kc - kcaches), kc->nfree, (int)kc->hits, (int)kc->refills,
+           (int)kc->steals, (int)kc->drains);
+  }
+}
@@ -1,7 +1,6 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          1  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
@@ -11,3 +10,16 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       1000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define CACHELINE     64   // bytes in a cache line
+#define NSLEEPQ       61   // buckets of the sleep queue hash
+#define KCACHE        64   // most free pages cached per CPU
+#define KBATCH        16   // pages moved at once to or from a cache
+#define MAXORDER      10   // largest kalloc_order() block is 2^MAXORDER pages
+
+// Build with KALLOCTEST=ON to self-test the buddy allocator at boot.
+#ifndef KALLOCTEST
+#define KALLOCTEST    0
+#endif
+#define NMLFQ        3     // MLFQ priority levels; level i runs 1<<i ticks
+#define MLFQ_BOOST   50    // ticks between MLFQ priority boosts
+#define CFS_MIN_GRAN 3     // ticks a CFS process runs before it can be preempted
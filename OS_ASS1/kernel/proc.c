@@ -4,9 +4,9 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "defs.h"
 
-uint64 pause_finish_tick = 0;
 uint64 rate = 5;
 uint64 running_time_mean = 0;
 uint64 runnable_time_mean = 0;
@@ -16,11 +16,91 @@ uint64 program_time = 0;
 uint64 start_time;
 uint64 cpu_utilization = 0;
 
+// The policy every CPU's scheduler() should be running.
+// SCHEDFLAG only picks the policy the system boots with;
+// set_policy() changes it at run time.
+#if defined(SJF)
+int sched_policy = SCHED_SJF;
+#elif defined(FCFS)
+int sched_policy = SCHED_FCFS;
+#else
+int sched_policy = SCHED_RR;
+#endif
+struct spinlock policy_lock;
+struct policystats policy_stats[NPOLICY];
+
+// Run queues of the policies that keep one. Every RUNNABLE
+// process that no CPU has picked yet sits on the run queue of
+// the active policy (p->rq_policy), or on none under round
+// robin, which walks the process table instead.
+// Lock order: p->lock, then rq_lock.
+struct spinlock rq_lock;
+struct runheap sjf_heap;
+struct runlist fcfs_list;
+struct runlist mlfq_lists[NMLFQ];
+uint64 mlfq_boost_tick;        // When the last priority boost happened
+int mlfq_epoch;                // Bumped by every priority boost
+
+#define MLFQ_QUANTUM(level) (1 << (level))
+
+struct runheap cfs_heap;
+uint64 cfs_min_vruntime;       // Never decreases; floor for arriving processes
+
+// CFS weight of each nice value, NICE_MIN first. Each step is
+// about 1.25x, so one nice level is worth about 10% of the CPU.
+#define NICE_0_WEIGHT 1024
+static const int nice_weights[NICE_MAX - NICE_MIN + 1] = {
+ 88761, 71755, 56483, 46273, 36291,
+ 29154, 23254, 18705, 14949, 11916,
+  9548,  7620,  6100,  4904,  3906,
+  3121,  2501,  1991,  1586,  1277,
+  1024,   820,   655,   526,   423,
+   335,   272,   215,   172,   137,
+   110,    87,    70,    56,    45,
+    36,    29,    23,    18,    15,
+};
+
+struct runheap stride_heap;
+uint64 stride_min_pass;        // Never decreases; floor for arriving processes
+
+#define STRIDE1 (1 << 20)
+#define STRIDE(p) (STRIDE1 / (p)->tickets)
+
+// While the system is paused (pause_finish_tick != 0), every
+// process but init and the shell is parked on paused_list
+// instead of a run queue, with rq_policy RQ_PAUSED, so no
+// scheduler looks at it. pause_tick() puts them all back on
+// the run queue in one go once the deadline has passed.
+// Both are protected by rq_lock.
+#define RQ_PAUSED NPOLICY
+uint64 pause_finish_tick;
+struct runlist paused_list;
+
+// Latency histograms of each CPU under each policy. Only the
+// CPU itself updates its own, with interrupts off.
+struct schedhist sched_hist[NCPU][NPOLICY];
+
+static char *policy_names[] = {
+[SCHED_RR]    "rr",
+[SCHED_SJF]   "sjf",
+[SCHED_FCFS]  "fcfs",
+[SCHED_MLFQ]  "mlfq",
+[SCHED_CFS]   "cfs",
+[SCHED_STRIDE] "stride",
+};
 
 struct cpu cpus[NCPU];
 
 struct proc proc[NPROC];
 
+// Sleep queues: sleeping processes hashed by chan, so that
+// wakeup() only looks at processes whose channels share a
+// bucket with chan. A process puts itself on its queue in
+// sleep() and takes itself off again when it wakes up, so
+// wakeup() and kill() only have to make it RUNNABLE.
+// Lock order: a queue's lock, then p->lock.
+struct sleepq sleepqs[NSLEEPQ];
+
 struct proc *initproc;
 
 int nextpid = 1;
@@ -28,6 +108,10 @@ struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static int sjf_before(struct proc *a, struct proc *b);
+static int cfs_before(struct proc *a, struct proc *b);
+static int stride_before(struct proc *a, struct proc *b);
+static void kick_idle_cpu(void);
 
 extern char trampoline[]; // trampoline.S
 
@@ -61,12 +145,21 @@ void procinit(void)
 
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  initlock(&policy_lock, "policy");
+  initlock(&rq_lock, "runq");
+  for (int i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepqs[i].lock, "sleepq");
+  sjf_heap.before = sjf_before;
+  cfs_heap.before = cfs_before;
+  stride_heap.before = stride_before;
   for (p = proc; p < &proc[NPROC]; p++)
   {
     initlock(&p->lock, "proc");
+    p->rq_policy = -1;
     p->kstack = KSTACK((int)(p - proc));
   }
   start_time = ticks;
+  policy_stats[sched_policy].active_since = ticks;
 }
 
 // Must be called with interrupts disabled,
@@ -147,6 +240,14 @@ found:
   p->total_running_time = 0;
   p->total_runnable_time = 0;
   p->total_sleeping_time = 0;
+  p->rq_policy = -1;
+  p->mlfq_level = 0;
+  p->mlfq_used = 0;
+  p->mlfq_epoch = mlfq_epoch;
+  p->nice = 0;
+  p->vruntime = 0;
+  p->tickets = DEFAULT_TICKETS;
+  p->pass = 0;
 
   // Allocate a trapframe page.
   if ((p->trapframe = (struct trapframe *)kalloc()) == 0)
@@ -272,6 +373,7 @@ void userinit(void)
   p->cwd = namei("/");
 
   p->state = RUNNABLE;
+  rq_add(p);
 
   release(&p->lock);
 }
@@ -299,6 +401,33 @@ int growproc(int n)
   return 0;
 }
 
+// Put child c on the list *l of its parent's children or zombies.
+// Caller must hold wait_lock.
+static void
+child_link(struct proc **l, struct proc *c)
+{
+  c->sibling_prev = 0;
+  c->sibling_next = *l;
+  if (*l)
+    (*l)->sibling_prev = c;
+  *l = c;
+}
+
+// Take child c off the list *l it is on.
+// Caller must hold wait_lock.
+static void
+child_unlink(struct proc **l, struct proc *c)
+{
+  if (c->sibling_prev)
+    c->sibling_prev->sibling_next = c->sibling_next;
+  else
+    *l = c->sibling_next;
+  if (c->sibling_next)
+    c->sibling_next->sibling_prev = c->sibling_prev;
+  c->sibling_next = 0;
+  c->sibling_prev = 0;
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 int fork(void)
@@ -336,16 +465,23 @@ int fork(void)
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  np->nice = p->nice;
+  np->vruntime = p->vruntime;
+  np->tickets = p->tickets;
+  np->pass = p->pass;
+
   pid = np->pid;
 
   release(&np->lock);
 
   acquire(&wait_lock);
   np->parent = p;
+  child_link(&p->children, np);
   release(&wait_lock);
 
   acquire(&np->lock);
   np->state = RUNNABLE;
+  rq_add(np);
   release(&np->lock);
 
   return pid;
@@ -357,13 +493,21 @@ void reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for (pp = proc; pp < &proc[NPROC]; pp++)
+  while ((pp = p->children) != 0)
   {
-    if (pp->parent == p)
+    child_unlink(&p->children, pp);
+    pp->parent = initproc;
+    child_link(&initproc->children, pp);
+  }
+  if (p->zombies)
+  {
+    while ((pp = p->zombies) != 0)
     {
+      child_unlink(&p->zombies, pp);
       pp->parent = initproc;
-      wakeup(initproc);
+      child_link(&initproc->zombies, pp);
     }
+    wakeup(initproc);
   }
 }
 
@@ -406,12 +550,17 @@ void exit(int status)
   p->xstate = status;
   p->state = ZOMBIE;
 
+  // Ready for the parent's wait() to reap.
+  child_unlink(&p->parent->children, p);
+  child_link(&p->parent->zombies, p);
+
   release(&wait_lock);
 
   sleeping_time_mean = ((sleeping_time_mean * number_process) + p->total_sleeping_time) / (number_process + 1);
   running_time_mean = ((running_time_mean * number_process) + p->total_running_time) / (number_process + 1) ;
   runnable_time_mean = ((runnable_time_mean * number_process) + p->total_runnable_time) / (number_process + 1) ;
   number_process += 1;
+  __sync_fetch_and_add(&policy_stats[mycpu()->policy].number_process, 1);
   program_time += p->total_running_time;
   cpu_utilization = (program_time * 100) / (ticks - start_time);
 
@@ -425,45 +574,36 @@ void exit(int status)
 int wait(uint64 addr)
 {
   struct proc *np;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for (;;)
   {
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for (np = proc; np < &proc[NPROC]; np++)
+    // Any exited child will do.
+    np = p->zombies;
+    if (np != 0)
     {
-      if (np->parent == p)
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      pid = np->pid;
+      if (addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                               sizeof(np->xstate)) < 0)
       {
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if (np->state == ZOMBIE)
-        {
-          // Found one.
-          pid = np->pid;
-          if (addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                   sizeof(np->xstate)) < 0)
-          {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
-          release(&np->lock);
-          release(&wait_lock);
-          return pid;
-        }
         release(&np->lock);
+        release(&wait_lock);
+        return -1;
       }
+      child_unlink(&p->zombies, np);
+      freeproc(np);
+      release(&np->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if (!havekids || p->killed)
+    if (p->children == 0 || p->killed)
     {
       release(&wait_lock);
       return -1;
@@ -474,17 +614,221 @@ int wait(uint64 addr)
   }
 }
 
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
-//  - swtch to start running that process.
-//  - eventually that process transfers control
-//    via swtch back to the scheduler.
+// A priority boost that happened while p was not on the MLFQ
+// run queue puts p back on the top level.
+static void
+mlfq_catch_up(struct proc *p)
+{
+  if (p->mlfq_epoch != mlfq_epoch)
+  {
+    p->mlfq_epoch = mlfq_epoch;
+    p->mlfq_level = 0;
+    p->mlfq_used = 0;
+  }
+}
+
+// Charge p for the ticks it just ran under MLFQ, and move it
+// one level down once it has used up its level's slice.
+// Caller must hold p->lock; p must not be on a run queue.
+static void
+mlfq_charge(struct proc *p)
+{
+  if (mycpu()->policy != SCHED_MLFQ)
+    return;
+  mlfq_catch_up(p);
+  p->mlfq_used += p->last_ticks_running;
+  if (p->mlfq_used >= MLFQ_QUANTUM(p->mlfq_level))
+  {
+    if (p->mlfq_level < NMLFQ - 1)
+      p->mlfq_level++;
+    p->mlfq_used = 0;
+  }
+}
+
+// Charge p for the ticks it just ran under CFS, at a rate
+// inversely proportional to its weight.
+// Caller must hold p->lock; p must not be on a run queue.
+static void
+cfs_charge(struct proc *p)
+{
+  if (mycpu()->policy != SCHED_CFS)
+    return;
+  p->vruntime += p->last_ticks_running * NICE_0_WEIGHT * NICE_0_WEIGHT / nice_weights[p->nice - NICE_MIN];
+}
+
+// Advance p's pass by one stride per tick it just ran.
+// Caller must hold p->lock; p must not be on a run queue.
+static void
+stride_charge(struct proc *p)
+{
+  if (mycpu()->policy != SCHED_STRIDE)
+    return;
+  p->pass += p->last_ticks_running * STRIDE(p);
+}
+
+// Move every queued process back to the top level, so that
+// long jobs sunk to the bottom cannot starve. Processes not
+// on the queue catch up with the boost in mlfq_catch_up().
+// Caller must hold rq_lock.
+static void
+mlfq_boost(void)
+{
+  struct proc *p;
+
+  mlfq_epoch++;
+  mlfq_boost_tick = ticks;
+  for (int i = 1; i < NMLFQ; i++)
+  {
+    while ((p = list_pop(&mlfq_lists[i])) != 0)
+    {
+      p->mlfq_level = 0;
+      list_push(&mlfq_lists[0], p);
+    }
+  }
+  for (p = mlfq_lists[0].head; p != 0; p = p->rq_next)
+  {
+    p->mlfq_epoch = mlfq_epoch;
+    p->mlfq_used = 0;
+  }
+}
+
+// Put p on the run queue of the active policy, if it keeps one.
+// Caller must hold p->lock and rq_lock.
+static void
+rq_insert(struct proc *p)
+{
+  switch (sched_policy)
+  {
+  case SCHED_SJF:
+    heap_push(&sjf_heap, p);
+    break;
+  case SCHED_FCFS:
+    list_push(&fcfs_list, p);
+    break;
+  case SCHED_MLFQ:
+    mlfq_catch_up(p);
+    list_push(&mlfq_lists[p->mlfq_level], p);
+    break;
+  case SCHED_CFS:
+    // Whatever p did not run while sleeping or under another
+    // policy is not owed to it; start it level with the rest.
+    if (p->vruntime < cfs_min_vruntime)
+      p->vruntime = cfs_min_vruntime;
+    heap_push(&cfs_heap, p);
+    break;
+  case SCHED_STRIDE:
+    if (p->pass < stride_min_pass)
+      p->pass = stride_min_pass;
+    heap_push(&stride_heap, p);
+    break;
+  default:
+    return;
+  }
+  p->rq_policy = sched_policy;
+}
+
+// Take p off whatever run queue holds it.
+// Caller must hold rq_lock.
+static void
+rq_delete(struct proc *p)
+{
+  switch (p->rq_policy)
+  {
+  case SCHED_SJF:
+    heap_remove(&sjf_heap, p);
+    break;
+  case SCHED_FCFS:
+    list_remove(&fcfs_list, p);
+    break;
+  case SCHED_MLFQ:
+    list_remove(&mlfq_lists[p->mlfq_level], p);
+    break;
+  case SCHED_CFS:
+    heap_remove(&cfs_heap, p);
+    break;
+  case SCHED_STRIDE:
+    heap_remove(&stride_heap, p);
+    break;
+  case RQ_PAUSED:
+    list_remove(&paused_list, p);
+    break;
+  }
+  p->rq_policy = -1;
+}
+
+// Hold p back until the system pause ends.
+// Caller must hold p->lock and rq_lock.
+static void
+rq_park(struct proc *p)
+{
+  list_push(&paused_list, p);
+  p->rq_policy = RQ_PAUSED;
+}
+
+// Only init and the shell run while the system is paused.
+static int
+pause_exempt(struct proc *p)
+{
+  return p->pid <= 2;
+}
+
+// p has just become RUNNABLE.
+// Caller must hold p->lock.
+void 
+rq_add(struct proc *p)
+{
+  acquire(&rq_lock);
+  p->arrival_ticks = ticks;
+  p->runnable_cycles = r_time();
+  if (pause_finish_tick != 0 && !pause_exempt(p))
+  {
+    rq_park(p);
+    release(&rq_lock);
+    return;
+  }
+  rq_insert(p);
+  release(&rq_lock);
+  kick_idle_cpu();
+}
+
+// p is about to run, so no other CPU may pick it.
+// Caller must hold p->lock.
+void 
+rq_remove(struct proc *p)
+{
+  acquire(&rq_lock);
+  rq_delete(p);
+  release(&rq_lock);
+}
+
+// SJF orders its heap by predicted burst.
+static int
+sjf_before(struct proc *a, struct proc *b)
+{
+  return a->mean_ticks < b->mean_ticks;
+}
+
+// CFS orders its heap by virtual runtime.
+static int
+cfs_before(struct proc *a, struct proc *b)
+{
+  return a->vruntime < b->vruntime;
+}
+
+// Stride orders its heap by pass.
+static int
+stride_before(struct proc *a, struct proc *b)
+{
+  return a->pass < b->pass;
+}
+
+// May p be picked by a scheduler now?
+// Caller must hold p->lock, which keeps p from being parked;
+// a stale RQ_PAUSED only delays p until the next pass.
 int 
 should_run_process(struct proc* p)
 {
-  if (p->state == RUNNABLE && ((p->pid <= 2 || pause_finish_tick <= ticks)))
+  if (p->state == RUNNABLE && p->rq_policy != RQ_PAUSED)
   {
     return 1;
   }
@@ -497,127 +841,407 @@ set_mean_ticks(struct proc *p)
   p->mean_ticks = ((10 - rate) * p->mean_ticks + p->last_ticks_running * rate) / 10;
 }
 
-void 
+// Histogram bucket of an interval of n time CSR cycles.
+static int
+hist_bucket(uint64 n)
+{
+  int b = 0;
+
+  while (n > 1 && b < NHIST - 1)
+  {
+    n >>= 1;
+    b++;
+  }
+  return b;
+}
+
+// Run p on c, if it is still RUNNABLE and was not parked
+// by a pause since it was popped. Returns 1 if it ran, 0 if not.
+int 
 run_process(struct proc *p, struct cpu *c)
 {
-  if (p->state != RUNNABLE)
+  struct schedhist *h = &sched_hist[cpuid()][c->policy];
+  uint64 start;
+
+  if (!should_run_process(p))
   {
-    return;
+    return 0;
   }
   // Switch to chosen process.  It is the process's job
   // to release its lock and then reacquire it
   // before jumping back to us.
+  rq_remove(p);
   p->state = RUNNING;
   p->start_running_ticks = ticks;
   p->last_ticks_runnable = ticks - p->start_runnable_ticks;
   p->total_runnable_time += p->last_ticks_runnable;
+  __sync_fetch_and_add(&policy_stats[c->policy].runnable_time, p->last_ticks_runnable);
+  start = r_time();
+  h->latency[hist_bucket(start - p->runnable_cycles)]++;
+  h->switches++;
   c->proc = p;
   swtch(&c->context, &p->context);
   // Process is done running for now.
   // It should have changed its p->state before coming back.
   c->proc = 0;
+  h->slice[hist_bucket(r_time() - start)]++;
+  return 1;
 }
-void 
-rr_sched(void)
+
+// One round-robin pass over the process table.
+// Each *_sched() returns how many processes it ran.
+int 
+rr_sched(struct cpu *c)
 {
-  printf("rr_sched\n");
   struct proc *p;
-  struct cpu *c = mycpu();
-  c->proc = 0;
-  for (;;)
+  int ran = 0;
+
+  for (p = proc; p < &proc[NPROC]; p++)
   {
-    // Avoid deadlock by ensuring that devices can interrupt.
-    intr_on();
-    for (p = proc; p < &proc[NPROC]; p++)
+    acquire(&p->lock);
+    // check if its not shell & init processes
+    if (should_run_process(p))
     {
-      acquire(&p->lock);
-      // check if its not shell & init processes
-      if (should_run_process(p))
-      {
-        run_process(p, c);
-      }
-      release(&p->lock);
+      ran += run_process(p, c);
     }
+    release(&p->lock);
   }
+  return ran;
 }
-void 
-sjf_sched(void)
+
+// Run the runnable process with the smallest mean_ticks,
+// taken from the top of the SJF heap.
+int 
+sjf_sched(struct cpu *c)
+{
+  struct proc *p;
+  int ran;
+
+  acquire(&rq_lock);
+  p = heap_pop(&sjf_heap);
+  if (p != 0)
+    p->rq_policy = -1;
+  release(&rq_lock);
+  if (p == 0)
+  {
+    return 0;
+  }
+
+  // p may have been run by a CPU still on another policy
+  // since we popped it; run_process() checks its state.
+  acquire(&p->lock);
+  ran = run_process(p, c);
+  release(&p->lock);
+  return ran;
+}
+
+// Run the runnable process that arrived first,
+// taken from the head of the FCFS list.
+int 
+fcfs_sched(struct cpu *c)
+{
+  struct proc *p;
+  int ran;
+
+  acquire(&rq_lock);
+  p = list_pop(&fcfs_list);
+  if (p != 0)
+    p->rq_policy = -1;
+  release(&rq_lock);
+  if (p == 0)
+  {
+    return 0;
+  }
+
+  acquire(&p->lock);
+  ran = run_process(p, c);
+  release(&p->lock);
+  return ran;
+}
+
+// Run the first process on the highest non-empty MLFQ level.
+int 
+mlfq_sched(struct cpu *c)
+{
+  struct proc *p = 0;
+  int ran;
+
+  acquire(&rq_lock);
+  if (ticks - mlfq_boost_tick >= MLFQ_BOOST)
+    mlfq_boost();
+  for (int i = 0; i < NMLFQ && p == 0; i++)
+    p = list_pop(&mlfq_lists[i]);
+  if (p != 0)
+    p->rq_policy = -1;
+  release(&rq_lock);
+  if (p == 0)
+  {
+    return 0;
+  }
+
+  acquire(&p->lock);
+  ran = run_process(p, c);
+  release(&p->lock);
+  return ran;
+}
+
+// Run the process with the smallest virtual runtime.
+int 
+cfs_sched(struct cpu *c)
+{
+  struct proc *p;
+  int ran;
+
+  acquire(&rq_lock);
+  p = heap_pop(&cfs_heap);
+  if (p != 0)
+  {
+    p->rq_policy = -1;
+    if (p->vruntime > cfs_min_vruntime)
+      cfs_min_vruntime = p->vruntime;
+  }
+  release(&rq_lock);
+  if (p == 0)
+  {
+    return 0;
+  }
+
+  acquire(&p->lock);
+  ran = run_process(p, c);
+  release(&p->lock);
+  return ran;
+}
+
+// Run the process with the smallest pass.
+int 
+stride_sched(struct cpu *c)
+{
+  struct proc *p;
+  int ran;
+
+  acquire(&rq_lock);
+  p = heap_pop(&stride_heap);
+  if (p != 0)
+  {
+    p->rq_policy = -1;
+    if (p->pass > stride_min_pass)
+      stride_min_pass = p->pass;
+  }
+  release(&rq_lock);
+  if (p == 0)
+  {
+    return 0;
+  }
+
+  acquire(&p->lock);
+  ran = run_process(p, c);
+  release(&p->lock);
+  return ran;
+}
+
+// Should the timer take the CPU away from the current process?
+// FCFS runs a process until it sleeps or exits. MLFQ lets it
+// finish the slice of its level unless a higher level has work.
+// CFS lets it run at least CFS_MIN_GRAN ticks, and after that
+// only switches if someone queued is behind it in virtual runtime.
+// The run queues are peeked at without rq_lock, which at worst
+// delays preemption by a tick.
+int 
+should_preempt(void)
+{
+  struct proc *p = myproc();
+  int policy, preempt = 1;
+
+  push_off();
+  policy = mycpu()->policy;
+  pop_off();
+
+  if (policy == SCHED_FCFS)
+    return 0;
+  if (policy == SCHED_MLFQ && p->mlfq_epoch == mlfq_epoch)
+  {
+    uint64 used = p->mlfq_used + ticks - p->start_running_ticks;
+    preempt = used >= MLFQ_QUANTUM(p->mlfq_level);
+    for (int i = 0; i < p->mlfq_level && !preempt; i++)
+      preempt = mlfq_lists[i].head != 0;
+  }
+  if (policy == SCHED_CFS)
+  {
+    uint64 ran = ticks - p->start_running_ticks;
+    uint64 vruntime = p->vruntime + ran * NICE_0_WEIGHT * NICE_0_WEIGHT / nice_weights[p->nice - NICE_MIN];
+    struct proc *next = heap_min(&cfs_heap);
+    preempt = ran >= CFS_MIN_GRAN && next != 0 && next->vruntime < vruntime;
+  }
+  return preempt;
+}
+
+// Is there anything for a CPU running policy to pick?
+// Peeks at the run queues without locks; only used to decide
+// whether to idle, and a stale answer costs at most a tick.
+static int
+has_work(int policy)
 {
-  printf("sjf_sched\n");
   struct proc *p;
+
+  if (policy != sched_policy)
+    return 1;
+  switch (policy)
+  {
+  case SCHED_SJF:
+    return sjf_heap.size > 0;
+  case SCHED_FCFS:
+    return fcfs_list.head != 0;
+  case SCHED_MLFQ:
+    for (int i = 0; i < NMLFQ; i++)
+      if (mlfq_lists[i].head != 0)
+        return 1;
+    return 0;
+  case SCHED_CFS:
+    return cfs_heap.size > 0;
+  case SCHED_STRIDE:
+    return stride_heap.size > 0;
+  }
+  for (p = proc; p < &proc[NPROC]; p++)
+    if (should_run_process(p))
+      return 1;
+  return 0;
+}
+
+// Nothing was runnable: sleep in wfi until a device interrupt,
+// the timer, or a wakeup IPI from kick_idle_cpu().
+// c->idle is published before the last look for work, and
+// interrupts stay off from there until wfi, which wakes on a
+// pending interrupt all the same. So work queued meanwhile is
+// either seen here, or its IPI ends the wfi.
+static void
+idle(struct cpu *c)
+{
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  if (!has_work(c->policy))
+    wfi();
+  c->idle = 0;
+  intr_on();
+}
+
+// Work was just queued: get one idle CPU out of wfi to run it.
+// Caller must have interrupts off.
+static void
+kick_idle_cpu(void)
+{
+  int me = cpuid();
+
+  __sync_synchronize();
+  for (int i = 0; i < NCPU; i++)
+  {
+    if (i != me && cpus[i].idle)
+    {
+      wakeup_hart(i);
+      return;
+    }
+  }
+}
+
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - pick up the active policy, in case set_policy() changed it.
+//  - choose a process to run under that policy.
+//  - swtch to start running that process.
+//  - eventually that process transfers control
+//    via swtch back to the scheduler.
+//  - if there was nothing to run, idle in wfi.
+// set_policy() moves the runnable set onto the new policy's
+// run queue, so a CPU that switches policy finds it there.
+void 
+scheduler(void)
+{
   struct cpu *c = mycpu();
-  struct proc *min_process;
+  int ran;
+
   c->proc = 0;
+  c->policy = -1;
   for (;;)
   {
-    uint min_ticks = -1;
+    // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
-    for (p = proc; p < &proc[NPROC]; p++)
+
+    if (c->policy != sched_policy)
     {
-      acquire(&p->lock);
-      if (should_run_process(p))
-      {
-        if (min_ticks == -1 || p->mean_ticks < min_ticks)
-        {
-          min_process = p;
-          min_ticks = p->mean_ticks;
-        }
-      }
-      release(&p->lock);
+      c->policy = sched_policy;
+      printf("cpu %d: %s_sched\n", cpuid(), policy_names[c->policy]);
     }
-    if (min_ticks == -1)
+
+    switch (c->policy)
     {
-      continue;
+    case SCHED_SJF:
+      ran = sjf_sched(c);
+      break;
+    case SCHED_FCFS:
+      ran = fcfs_sched(c);
+      break;
+    case SCHED_MLFQ:
+      ran = mlfq_sched(c);
+      break;
+    case SCHED_CFS:
+      ran = cfs_sched(c);
+      break;
+    case SCHED_STRIDE:
+      ran = stride_sched(c);
+      break;
+    default:
+      ran = rr_sched(c);
+      break;
     }
-    acquire(&min_process->lock);
-    run_process(min_process, c);
-    release(&min_process->lock);
+
+    if (!ran)
+      idle(c);
   }
 }
-void 
-fcfs_sched(){
-  printf("fcfs_sched\n");
+
+// Make policy the active scheduling policy on all CPUs.
+// Each CPU switches before its next scheduling decision.
+int 
+set_policy(int policy)
+{
   struct proc *p;
-  struct cpu *c = mycpu();
-  struct proc *min_process;
-  c->proc = 0;
-  for (;;)
+
+  if (policy < 0 || policy >= NPOLICY)
+    return -1;
+
+  acquire(&policy_lock);
+  if (policy != sched_policy)
   {
-    uint min_runnable_ticks = -1;
-    intr_on();
+    policy_stats[sched_policy].active_ticks += ticks - policy_stats[sched_policy].active_since;
+    policy_stats[policy].active_since = ticks;
+    acquire(&rq_lock);
+    sched_policy = policy;
+    release(&rq_lock);
+
+    // Hand the runnable set over to the new policy's run queue.
+    // Processes that become RUNNABLE from now on go there directly.
     for (p = proc; p < &proc[NPROC]; p++)
     {
       acquire(&p->lock);
-      if (should_run_process(p))
+      acquire(&rq_lock);
+      if (p->state == RUNNABLE && p->rq_policy != policy && p->rq_policy != RQ_PAUSED)
       {
-        if (min_runnable_ticks == -1 || p->last_ticks_runnable < min_runnable_ticks)
-        {
-          min_process = p;
-          min_runnable_ticks = p->last_ticks_runnable;
-        }
+        rq_delete(p);
+        rq_insert(p);
       }
+      release(&rq_lock);
       release(&p->lock);
     }
-    if (min_runnable_ticks == -1)
-    {
-      continue;
-    }
-    acquire(&min_process->lock);
-    run_process(min_process, c);
-    release(&min_process->lock);
   }
+  release(&policy_lock);
+  return 0;
 }
 
-void 
-scheduler(void)
+int 
+get_policy(void)
 {
-  #ifdef DEFAULT
-      rr_sched();
-  #elif SJF
-      sjf_sched();
-  #elif FCFS
-      fcfs_sched();
-  #endif
+  return sched_policy;
 }
 
 // Switch to scheduler.  Must hold only p->lock
@@ -655,7 +1279,12 @@ void yield(void)
   p->start_runnable_ticks = ticks;
   p->last_ticks_running = ticks - p->start_running_ticks;
   p->total_running_time += p->last_ticks_running;
+  __sync_fetch_and_add(&policy_stats[mycpu()->policy].running_time, p->last_ticks_running);
   set_mean_ticks(p);
+  mlfq_charge(p);
+  cfs_charge(p);
+  stride_charge(p);
+  rq_add(p);
   sched();
   release(&p->lock);
 }
@@ -681,36 +1310,66 @@ void forkret(void)
   usertrapret();
 }
 
+// The sleep queue of chan, see sleepqs.
+static struct sleepq*
+sleepq_of(void *chan)
+{
+  return &sleepqs[((uint64)chan >> 3) % NSLEEPQ];
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *q = sleepq_of(chan);
 
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
-  // so it's okay to release lk.
+  // Once we are on chan's sleep queue and hold
+  // p->lock, we can be guaranteed that we won't
+  // miss any wakeup (wakeup locks the queue and
+  // then p->lock), so it's okay to release lk.
 
+  acquire(&q->lock);
   acquire(&p->lock); // DOC: sleeplock1
-  release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->sq_prev = 0;
+  p->sq_next = q->head;
+  if (q->head)
+    q->head->sq_prev = p;
+  q->head = p;
+  release(&q->lock);
+  release(lk);
+
   p->start_sleeping_ticks = ticks;
   p->last_ticks_running = ticks - p->start_running_ticks;
   p->total_running_time += p->last_ticks_running;
+  __sync_fetch_and_add(&policy_stats[mycpu()->policy].running_time, p->last_ticks_running);
   set_mean_ticks(p);
+  mlfq_charge(p);
+  cfs_charge(p);
+  stride_charge(p);
   sched();
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  // Until we are off the queue, wakeup() skips us for our chan.
+  acquire(&q->lock);
+  if (p->sq_prev)
+    p->sq_prev->sq_next = p->sq_next;
+  else
+    q->head = p->sq_next;
+  if (p->sq_next)
+    p->sq_next->sq_prev = p->sq_prev;
+  release(&q->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
@@ -718,23 +1377,29 @@ void sleep(void *chan, struct spinlock *lk)
 // Must be called without any p->lock.
 void wakeup(void *chan)
 {
+  struct sleepq *q = sleepq_of(chan);
   struct proc *p;
 
-  for (p = proc; p < &proc[NPROC]; p++)
+  acquire(&q->lock);
+  for (p = q->head; p != 0; p = p->sq_next)
   {
-    if (p != myproc())
+    // Only a process that is no longer asleep changes its chan
+    // without q->lock, so others' channels can be skipped unlocked.
+    if (p->chan != chan)
+      continue;
+    acquire(&p->lock);
+    if (p->state == SLEEPING && p->chan == chan)
     {
-      acquire(&p->lock);
-      if (p->state == SLEEPING && p->chan == chan)
-      {
-        p->state = RUNNABLE;
-        p->last_ticks_sleeping = ticks - p->start_sleeping_ticks;
-        p->total_sleeping_time += p->last_ticks_sleeping;
-        p->start_runnable_ticks = ticks;
-      }
-      release(&p->lock);
+      p->state = RUNNABLE;
+      p->last_ticks_sleeping = ticks - p->start_sleeping_ticks;
+      p->total_sleeping_time += p->last_ticks_sleeping;
+      __sync_fetch_and_add(&policy_stats[sched_policy].sleeping_time, p->last_ticks_sleeping);
+      p->start_runnable_ticks = ticks;
+      rq_add(p);
     }
+    release(&p->lock);
   }
+  release(&q->lock);
 }
 
 // Kill the process with the given pid.
@@ -754,6 +1419,7 @@ int kill(int pid)
       {
         // Wake process from sleep().
         p->state = RUNNABLE;
+        rq_add(p);
       }
       release(&p->lock);
       return 0;
@@ -763,6 +1429,164 @@ int kill(int pid)
   return -1;
 }
 
+// Copy the scheduling statistics of the process with the
+// given pid out to user address addr.
+int 
+getprocstats(int pid, uint64 addr)
+{
+  struct proc *p;
+  struct procstats st;
+
+  // zero the padding too, so no kernel stack leaks to user space.
+  memset(&st, 0, sizeof(st));
+  for (p = proc; p < &proc[NPROC]; p++)
+  {
+    acquire(&p->lock);
+    if (p->pid == pid && p->state != UNUSED)
+    {
+      st.pid = p->pid;
+      st.state = p->state;
+      safestrcpy(st.name, p->name, sizeof(st.name));
+      st.nice = p->nice;
+      st.tickets = p->tickets;
+      st.mlfq_level = p->mlfq_level;
+      st.mean_ticks = p->mean_ticks;
+      st.last_ticks_running = p->last_ticks_running;
+      st.last_ticks_runnable = p->last_ticks_runnable;
+      st.last_ticks_sleeping = p->last_ticks_sleeping;
+      st.total_running_time = p->total_running_time;
+      st.total_runnable_time = p->total_runnable_time;
+      st.total_sleeping_time = p->total_sleeping_time;
+      release(&p->lock);
+      return copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st));
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Copy the system-wide scheduling statistics, and the pids of
+// all live processes, out to user address addr.
+int 
+getsysstats(uint64 addr)
+{
+  struct proc *p;
+  struct sysstats st;
+
+  memset(&st, 0, sizeof(st));
+  st.ticks = ticks;
+  st.running_time_mean = running_time_mean;
+  st.runnable_time_mean = runnable_time_mean;
+  st.sleeping_time_mean = sleeping_time_mean;
+  st.number_process = number_process;
+  st.program_time = program_time;
+  st.cpu_utilization = cpu_utilization;
+
+  acquire(&policy_lock);
+  st.policy = sched_policy;
+  memmove(st.policies, policy_stats, sizeof(st.policies));
+  st.policies[sched_policy].active_ticks += st.ticks - policy_stats[sched_policy].active_since;
+  release(&policy_lock);
+
+  for (p = proc; p < &proc[NPROC]; p++)
+  {
+    acquire(&p->lock);
+    if (p->state != UNUSED)
+      st.pids[st.nprocs++] = p->pid;
+    release(&p->lock);
+  }
+  return copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st));
+}
+
+// Copy the latency histograms of policy, summed over all
+// CPUs, out to user address addr.
+int 
+getschedhist(int policy, uint64 addr)
+{
+  struct schedhist st;
+
+  if (policy < 0 || policy >= NPOLICY)
+    return -1;
+  memset(&st, 0, sizeof(st));
+  for (int i = 0; i < NCPU; i++)
+  {
+    struct schedhist *h = &sched_hist[i][policy];
+    for (int b = 0; b < NHIST; b++)
+    {
+      st.latency[b] += h->latency[b];
+      st.slice[b] += h->slice[b];
+    }
+    st.switches += h->switches;
+  }
+  return copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st));
+}
+
+// Set the nice value of the process with the given pid.
+int 
+setnice(int pid, int nice)
+{
+  struct proc *p;
+
+  if (nice < NICE_MIN || nice > NICE_MAX)
+    return -1;
+  for (p = proc; p < &proc[NPROC]; p++)
+  {
+    acquire(&p->lock);
+    if (p->pid == pid)
+    {
+      p->nice = nice;
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Return the nice value of the process with the given pid,
+// or NICE_MIN - 1 if there is none.
+int 
+getnice(int pid)
+{
+  struct proc *p;
+  int nice;
+
+  for (p = proc; p < &proc[NPROC]; p++)
+  {
+    acquire(&p->lock);
+    if (p->pid == pid)
+    {
+      nice = p->nice;
+      release(&p->lock);
+      return nice;
+    }
+    release(&p->lock);
+  }
+  return NICE_MIN - 1;
+}
+
+// Give the process with the given pid n stride tickets.
+int 
+settickets(int pid, int n)
+{
+  struct proc *p;
+
+  if (n < 1 || n > MAX_TICKETS)
+    return -1;
+  for (p = proc; p < &proc[NPROC]; p++)
+  {
+    acquire(&p->lock);
+    if (p->pid == pid)
+    {
+      p->tickets = n;
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
 // Copy to either a user address, or kernel address,
 // depending on usr_dst.
 // Returns 0 on success, -1 on error.
@@ -823,15 +1647,72 @@ void procdump(void)
     printf("%d %s %s", p->pid, state, p->name);
     printf("\n");
   }
+  kmemdump();
+  kmem_cache_dump();
 }
 
+// Stop every process but init and the shell for the given
+// number of seconds. The runnable ones are parked here, and
+// the rest as they become RUNNABLE, so the CPUs idle in wfi
+// until pause_tick() lets them all go at the deadline.
 int pause_system(int seconds)
 {
+  struct proc *p;
+
+  acquire(&rq_lock);
   pause_finish_tick = ticks + (seconds * 10);
+  release(&rq_lock);
+
+  for (p = proc; p < &proc[NPROC]; p++)
+  {
+    acquire(&p->lock);
+    acquire(&rq_lock);
+    if (pause_finish_tick != 0 && p->state == RUNNABLE && !pause_exempt(p) && p->rq_policy != RQ_PAUSED)
+    {
+      rq_delete(p);
+      rq_park(p);
+    }
+    release(&rq_lock);
+    release(&p->lock);
+  }
   yield();
   return 0;
 }
 
+// Called by clockintr() on every tick. Once the pause deadline
+// has passed, move all parked processes onto the run queue at
+// once and get the idle CPUs going on them.
+void
+pause_tick(void)
+{
+  struct proc *p;
+
+  // Peek first; almost every tick there is no pause.
+  if (pause_finish_tick == 0 || ticks < pause_finish_tick)
+    return;
+
+  acquire(&rq_lock);
+  if (pause_finish_tick != 0 && ticks >= pause_finish_tick)
+  {
+    pause_finish_tick = 0;
+    // Parked processes are not touched by anyone but holders
+    // of rq_lock, so p->lock is not needed to queue them.
+    while ((p = list_pop(&paused_list)) != 0)
+    {
+      p->rq_policy = -1;
+      rq_insert(p);
+    }
+  }
+  release(&rq_lock);
+
+  __sync_synchronize();
+  for (int i = 0; i < NCPU; i++)
+  {
+    if (i != cpuid() && cpus[i].idle)
+      wakeup_hart(i);
+  }
+}
+
 int kill_system()
 {
   struct proc *p;
@@ -855,4 +1736,21 @@ print_stats(){
     printf("sleeping_time_mean: %d\n", sleeping_time_mean);
     printf("cpu_utilization: %d\n", cpu_utilization);
     printf("program_time: %d\n", program_time);
+
+    acquire(&policy_lock);
+    for (int i = 0; i < NPOLICY; i++)
+    {
+      struct policystats *ps = &policy_stats[i];
+      uint64 active = ps->active_ticks;
+      uint64 n = ps->number_process;
+      if (i == sched_policy)
+        active += ticks - ps->active_since;
+      printf("%s%s: active_ticks %d", policy_names[i], i == sched_policy ? "*" : "", active);
+      printf(" running_time_mean %d", n ? ps->running_time / n : 0);
+      printf(" runnable_time_mean %d", n ? ps->runnable_time / n : 0);
+      printf(" sleeping_time_mean %d", n ? ps->sleeping_time / n : 0);
+      printf(" number_process %d", n);
+      printf(" cpu_utilization %d\n", active ? (ps->running_time * 100) / active : 0);
+    }
+    release(&policy_lock);
 }
\ No newline at end of file
@@ -24,6 +24,8 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int policy;                 // Policy this CPU's scheduler() is running.
+  volatile int idle;          // In wfi, waiting for work? See idle().
 };
 
 extern struct cpu cpus[NCPU];
@@ -93,8 +95,16 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
+  // the lock of chan's sleep queue must be held when using these:
+  struct proc *sq_next;        // Other processes on the same sleep queue
+  struct proc *sq_prev;
+
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
+  struct proc *children;       // Children that have not exited
+  struct proc *zombies;        // Children that have exited, not yet waited for
+  struct proc *sibling_next;   // Next and previous on parent's children
+  struct proc *sibling_prev;   // or zombies list
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
@@ -116,4 +126,47 @@ struct proc {
   uint64 total_running_time;
   uint64 total_runnable_time;
   uint64 total_sleeping_time;
+
+  // rq_lock must be held when using these:
+  int rq_policy;               // Policy whose run queue holds p, or -1
+  int rq_index;                // Slot in that run queue's heap
+  struct proc *rq_next;        // Neighbours in that run queue's list
+  struct proc *rq_prev;
+  uint64 arrival_ticks;        // Tick at which p last became RUNNABLE
+  uint64 runnable_cycles;      // Time CSR when p last became RUNNABLE
+
+  // MLFQ priority. Changed by p itself while running, or by
+  // a priority boost while p is on the MLFQ run queue.
+  int mlfq_level;              // 0 is the highest priority
+  uint64 mlfq_used;            // Ticks of the slice at mlfq_level used so far
+  int mlfq_epoch;              // Last boost p has seen
+
+  // CFS. nice needs p->lock; vruntime is changed by p itself
+  // while running, or under rq_lock while p is queued.
+  int nice;                    // NICE_MIN..NICE_MAX, sets p's CFS weight
+  uint64 vruntime;             // Ticks run, scaled by NICE_0_WEIGHT/weight
+
+  // Stride. tickets needs p->lock; pass is kept like vruntime.
+  int tickets;                 // 1..MAX_TICKETS, sets p's stride
+  uint64 pass;                 // Ticks run, scaled by STRIDE1/tickets
+};
+
+// A run queue kept as a binary min-heap (runq.c).
+struct runheap {
+  struct proc *procs[NPROC];
+  int size;
+  int (*before)(struct proc *, struct proc *);  // Ordering of the heap
+};
+
+// A run queue kept as a FIFO list in arrival_ticks order (runq.c).
+struct runlist {
+  struct proc *head;
+  struct proc *tail;
+};
+
+// Processes sleeping on channels that hash to the same
+// bucket, see sleep() in proc.c.
+struct sleepq {
+  struct spinlock lock;
+  struct proc *head;
 };
@@ -276,6 +276,13 @@ intr_on()
   w_sstatus(r_sstatus() | SSTATUS_SIE);
 }
 
+// sleep until an interrupt is pending, even a disabled one.
+static inline void
+wfi()
+{
+  asm volatile("wfi");
+}
+
 // disable device interrupts
 static inline void
 intr_off()
@@ -0,0 +1,154 @@
+// Run queue data structures for the scheduling policies.
+// These only order processes; the caller holds the lock
+// that protects the queue (rq_lock in proc.c).
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+
+// Binary min-heap of processes, ordered by h->before.
+// Each process remembers its slot in rq_index so that
+// it can be removed from the middle in O(log n).
+
+static void
+heap_swap(struct runheap *h, int i, int j)
+{
+  struct proc *t = h->procs[i];
+
+  h->procs[i] = h->procs[j];
+  h->procs[j] = t;
+  h->procs[i]->rq_index = i;
+  h->procs[j]->rq_index = j;
+}
+
+static void
+heap_up(struct runheap *h, int i)
+{
+  while(i > 0 && h->before(h->procs[i], h->procs[(i-1)/2])){
+    heap_swap(h, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static void
+heap_down(struct runheap *h, int i)
+{
+  int l, r, min;
+
+  for(;;){
+    min = i;
+    l = 2*i + 1;
+    r = 2*i + 2;
+    if(l < h->size && h->before(h->procs[l], h->procs[min]))
+      min = l;
+    if(r < h->size && h->before(h->procs[r], h->procs[min]))
+      min = r;
+    if(min == i)
+      return;
+    heap_swap(h, i, min);
+    i = min;
+  }
+}
+
+void
+heap_push(struct runheap *h, struct proc *p)
+{
+  if(h->size >= NPROC)
+    panic("heap_push");
+  h->procs[h->size] = p;
+  p->rq_index = h->size;
+  h->size++;
+  heap_up(h, p->rq_index);
+}
+
+// Return the first process without removing it, or 0 if empty.
+struct proc*
+heap_min(struct runheap *h)
+{
+  if(h->size == 0)
+    return 0;
+  return h->procs[0];
+}
+
+void
+heap_remove(struct runheap *h, struct proc *p)
+{
+  int i = p->rq_index;
+
+  if(i < 0 || i >= h->size || h->procs[i] != p)
+    panic("heap_remove");
+  h->size--;
+  if(i != h->size){
+    heap_swap(h, i, h->size);
+    heap_down(h, i);
+    heap_up(h, i);
+  }
+  p->rq_index = -1;
+}
+
+// Remove and return the first process, or 0 if empty.
+struct proc*
+heap_pop(struct runheap *h)
+{
+  struct proc *p = heap_min(h);
+
+  if(p)
+    heap_remove(h, p);
+  return p;
+}
+
+// FIFO list of processes, linked through rq_next and rq_prev
+// and kept in arrival_ticks order.
+
+void
+list_push(struct runlist *l, struct proc *p)
+{
+  struct proc *q = l->tail;
+
+  // A process that just became RUNNABLE arrives last and goes
+  // straight to the tail. Only a policy handover brings in
+  // older arrivals that belong further up.
+  while(q && q->arrival_ticks > p->arrival_ticks)
+    q = q->rq_prev;
+
+  // Insert p after q, or at the head if q is 0.
+  p->rq_prev = q;
+  p->rq_next = q ? q->rq_next : l->head;
+  if(p->rq_next)
+    p->rq_next->rq_prev = p;
+  else
+    l->tail = p;
+  if(q)
+    q->rq_next = p;
+  else
+    l->head = p;
+}
+
+void
+list_remove(struct runlist *l, struct proc *p)
+{
+  if(p->rq_prev)
+    p->rq_prev->rq_next = p->rq_next;
+  else
+    l->head = p->rq_next;
+  if(p->rq_next)
+    p->rq_next->rq_prev = p->rq_prev;
+  else
+    l->tail = p->rq_prev;
+  p->rq_next = 0;
+  p->rq_prev = 0;
+}
+
+// Remove and return the earliest arrival, or 0 if empty.
+struct proc*
+list_pop(struct runlist *l)
+{
+  struct proc *p = l->head;
+
+  if(p)
+    list_remove(l, p);
+  return p;
+}
@@ -0,0 +1,74 @@
+// Scheduling policies, selectable at run time with set_policy().
+#define SCHED_RR    0   // Round robin
+#define SCHED_SJF   1   // Shortest job first (by mean_ticks)
+#define SCHED_FCFS  2   // First come first served
+#define SCHED_MLFQ  3   // Multi-level feedback queue
+#define SCHED_CFS   4   // Fair share by nice-weighted virtual runtime
+#define SCHED_STRIDE 5  // Proportional share by tickets
+#define NPOLICY     6
+
+// Nice values for setnice(), as in Unix: lower runs more.
+#define NICE_MIN  (-20)
+#define NICE_MAX  19
+
+// Tickets for settickets(); a process's CPU share under the
+// stride policy is proportional to its tickets.
+#define DEFAULT_TICKETS  100
+#define MAX_TICKETS      10000
+
+// Scheduling statistics kept separately for each policy,
+// so that policies can be compared under the same load.
+// Ticks are charged to the policy that was active when
+// the interval ended.
+struct policystats {
+  uint64 running_time;         // Ticks processes spent RUNNING
+  uint64 runnable_time;        // Ticks processes spent RUNNABLE
+  uint64 sleeping_time;        // Ticks processes spent SLEEPING
+  uint64 number_process;       // Processes that exited under this policy
+  uint64 active_ticks;         // Ticks this policy was active, up to active_since
+  uint64 active_since;         // Tick at which this policy last became active
+};
+
+// Snapshot of one process, copied out by getprocstats().
+struct procstats {
+  int pid;
+  int state;                   // enum procstate in proc.h
+  char name[16];
+  int nice;
+  int tickets;
+  int mlfq_level;
+  uint64 mean_ticks;
+  uint64 last_ticks_running;
+  uint64 last_ticks_runnable;
+  uint64 last_ticks_sleeping;
+  uint64 total_running_time;
+  uint64 total_runnable_time;
+  uint64 total_sleeping_time;
+};
+
+// Snapshot of the whole system, copied out by getsysstats().
+// Needs param.h for NPROC.
+struct sysstats {
+  uint64 ticks;
+  int policy;                  // Active policy
+  int nprocs;                  // Live processes, listed in pids[]
+  int pids[NPROC];
+  uint64 running_time_mean;    // Means over all exited processes
+  uint64 runnable_time_mean;
+  uint64 sleeping_time_mean;
+  uint64 number_process;
+  uint64 program_time;
+  uint64 cpu_utilization;
+  struct policystats policies[NPOLICY];  // active_ticks counted up to ticks
+};
+
+// Scheduling latency histograms, copied out by getschedhist().
+// Bucket i counts intervals of [2^i, 2^(i+1)) time CSR cycles
+// (bucket 0 also holds 0); the time CSR runs at TIMEBASE_HZ.
+#define NHIST        32
+#define TIMEBASE_HZ  10000000   // qemu virt
+struct schedhist {
+  uint64 latency[NHIST];       // RUNNABLE until picked to run
+  uint64 slice[NHIST];         // Running until back in the scheduler
+  uint64 switches;             // Context switches into a process
+};
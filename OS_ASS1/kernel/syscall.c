@@ -107,6 +107,14 @@ extern uint64 sys_uptime(void);
 extern uint64 sys_pause_system(void);
 extern uint64 sys_kill_system(void);
 extern uint64 sys_print_stats(void);
+extern uint64 sys_set_policy(void);
+extern uint64 sys_get_policy(void);
+extern uint64 sys_setnice(void);
+extern uint64 sys_getnice(void);
+extern uint64 sys_settickets(void);
+extern uint64 sys_getprocstats(void);
+extern uint64 sys_getsysstats(void);
+extern uint64 sys_getschedhist(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -133,6 +141,14 @@ static uint64 (*syscalls[])(void) = {
 [SYS_pause_system] sys_pause_system,
 [SYS_kill_system] sys_kill_system,
 [SYS_print_stats] sys_print_stats,
+[SYS_set_policy] sys_set_policy,
+[SYS_get_policy] sys_get_policy,
+[SYS_setnice] sys_setnice,
+[SYS_getnice] sys_getnice,
+[SYS_settickets] sys_settickets,
+[SYS_getprocstats] sys_getprocstats,
+[SYS_getsysstats] sys_getsysstats,
+[SYS_getschedhist] sys_getschedhist,
 };
 
 void
@@ -23,3 +23,11 @@
 #define SYS_pause_system 22
 #define SYS_kill_system 23
 #define SYS_print_stats 24
+#define SYS_set_policy 25
+#define SYS_get_policy 26
+#define SYS_setnice 27
+#define SYS_getnice 28
+#define SYS_settickets 29
+#define SYS_getprocstats 30
+#define SYS_getsysstats 31
+#define SYS_getschedhist 32
@@ -118,3 +118,81 @@ sys_print_stats(void)
   print_stats();
   return 0;
 }
+
+uint64
+sys_set_policy(void)
+{
+  int policy;
+  if(argint(0, &policy) < 0){
+    return -1;
+  }
+  return set_policy(policy);
+}
+
+uint64
+sys_get_policy(void)
+{
+  return get_policy();
+}
+
+uint64
+sys_setnice(void)
+{
+  int pid, nice;
+  if(argint(0, &pid) < 0 || argint(1, &nice) < 0){
+    return -1;
+  }
+  return setnice(pid, nice);
+}
+
+uint64
+sys_getnice(void)
+{
+  int pid;
+  if(argint(0, &pid) < 0){
+    return -1;
+  }
+  return getnice(pid);
+}
+
+uint64
+sys_settickets(void)
+{
+  int pid, n;
+  if(argint(0, &pid) < 0 || argint(1, &n) < 0){
+    return -1;
+  }
+  return settickets(pid, n);
+}
+
+uint64
+sys_getprocstats(void)
+{
+  int pid;
+  uint64 st;
+  if(argint(0, &pid) < 0 || argaddr(1, &st) < 0){
+    return -1;
+  }
+  return getprocstats(pid, st);
+}
+
+uint64
+sys_getsysstats(void)
+{
+  uint64 st;
+  if(argaddr(0, &st) < 0){
+    return -1;
+  }
+  return getsysstats(st);
+}
+
+uint64
+sys_getschedhist(void)
+{
+  int policy;
+  uint64 st;
+  if(argint(0, &policy) < 0 || argaddr(1, &st) < 0){
+    return -1;
+  }
+  return getschedhist(policy, st);
+}
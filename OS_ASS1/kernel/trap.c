@@ -77,7 +77,7 @@ usertrap(void)
     exit(-1);
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  if(which_dev == 2 && should_preempt())
     yield();
 
   usertrapret();
@@ -150,7 +150,7 @@ kerneltrap()
   }
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
+  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING && should_preempt())
     yield();
 
   // the yield() may have caused some traps to occur,
@@ -166,12 +166,14 @@ clockintr()
   ticks++;
   wakeup(&ticks);
   release(&tickslock);
+  pause_tick();
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
 // 1 if other device,
+// 3 if wakeup IPI from another hart,
 // 0 if not recognized.
 int
 devintr()
@@ -202,16 +204,21 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000001L){
     // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // or from a wakeup IPI, forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
+    // a wakeup IPI only had to get this hart out of wfi;
+    // the scheduler loop will find the work it was sent for.
+    if(!timer_fired())
+      return 3;
+
+    if(cpuid() == 0){
+      clockintr();
+    }
+
     return 2;
   } else {
     return 0;
@@ -0,0 +1,54 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Run a command with a nice value, or change that of a process.
+//   nice 5 sh         run sh at nice 5
+//   nice -p 7 -3      set the nice value of pid 7 to -3
+//   nice -p 7         print the nice value of pid 7
+
+// atoi() with an optional leading minus sign.
+int
+niceval(char *s)
+{
+  if(*s == '-')
+    return -atoi(s + 1);
+  return atoi(s);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nice, pid;
+
+  if(argc >= 3 && strcmp(argv[1], "-p") == 0){
+    pid = atoi(argv[2]);
+    if(argc == 3){
+      if((nice = getnice(pid)) < NICE_MIN){
+        fprintf(2, "nice: no process %d\n", pid);
+        exit(1);
+      }
+      printf("%d\n", nice);
+      exit(0);
+    }
+    if(setnice(pid, niceval(argv[3])) < 0){
+      fprintf(2, "nice: cannot set pid %d to %s\n", pid, argv[3]);
+      exit(1);
+    }
+    exit(0);
+  }
+
+  if(argc < 3){
+    fprintf(2, "usage: nice value command [args...] | nice -p pid [value]\n");
+    exit(1);
+  }
+  if(setnice(getpid(), niceval(argv[1])) < 0){
+    fprintf(2, "nice: bad value %s\n", argv[1]);
+    exit(1);
+  }
+  exec(argv[2], argv + 2);
+  fprintf(2, "nice: exec %s failed\n", argv[2]);
+  exit(1);
+}
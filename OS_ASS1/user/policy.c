@@ -0,0 +1,39 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Show or change the scheduling policy of the running system.
+//   policy            print the active policy
+//   policy sjf        switch every CPU to SJF
+
+char *names[] = {
+[SCHED_RR]    "rr",
+[SCHED_SJF]   "sjf",
+[SCHED_FCFS]  "fcfs",
+[SCHED_MLFQ]  "mlfq",
+[SCHED_CFS]   "cfs",
+[SCHED_STRIDE] "stride",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  if(argc < 2){
+    printf("%s\n", names[get_policy()]);
+    exit(0);
+  }
+
+  for(i = 0; i < NPOLICY; i++){
+    if(strcmp(argv[1], names[i]) == 0)
+      break;
+  }
+  if(i == NPOLICY || set_policy(i) < 0){
+    fprintf(2, "usage: policy [rr|sjf|fcfs|mlfq|cfs|stride]\n");
+    exit(1);
+  }
+  exit(0);
+}
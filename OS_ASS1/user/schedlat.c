@@ -0,0 +1,55 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Print scheduling latency and slice percentiles of every
+// policy that has run something, from getschedhist().
+
+char *policies[] = {
+[SCHED_RR]     "rr",
+[SCHED_SJF]    "sjf",
+[SCHED_FCFS]   "fcfs",
+[SCHED_MLFQ]   "mlfq",
+[SCHED_CFS]    "cfs",
+[SCHED_STRIDE] "stride",
+};
+
+// Upper bound, in microseconds, of the bucket that holds
+// the pct-th percentile of histogram h.
+int
+percentile(uint64 *h, int pct)
+{
+  uint64 total = 0, seen = 0;
+  int b;
+
+  for(b = 0; b < NHIST; b++)
+    total += h[b];
+  for(b = 0; b < NHIST; b++){
+    seen += h[b];
+    if(seen * 100 >= total * pct)
+      break;
+  }
+  return (int)((2UL << b) / (TIMEBASE_HZ / 1000000));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct schedhist h;
+
+  printf("policy\tswitches\tlat p50\tlat p99\tslice p50\tslice p99 (us, upper bound)\n");
+  for(int i = 0; i < NPOLICY; i++){
+    if(getschedhist(i, &h) < 0){
+      fprintf(2, "schedlat: getschedhist failed\n");
+      exit(1);
+    }
+    if(h.switches == 0)
+      continue;
+    printf("%s\t%d\t\t%d\t%d\t%d\t\t%d\n", policies[i], (int)h.switches,
+           percentile(h.latency, 50), percentile(h.latency, 99),
+           percentile(h.slice, 50), percentile(h.slice, 99));
+  }
+  exit(0);
+}
@@ -0,0 +1,87 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Stride scheduling benchmark: run CPU-bound children with
+// different ticket counts side by side under the stride policy
+// and print the share of the work each of them got done.
+//   stride [ticks [tickets...]]
+
+#define MAXCHILD 8
+
+// What a child reports when its time is up. Sent with one write(),
+// so that records of children finishing together cannot interleave.
+struct result {
+  int who;
+  uint64 count;
+};
+
+int
+main(int argc, char *argv[])
+{
+  int tickets[MAXCHILD] = { 100, 200, 300 };
+  uint64 work[MAXCHILD], total;
+  int n = 3, duration = 100, fd[2], old, i, pid;
+  struct result r;
+
+  if(argc > 1)
+    duration = atoi(argv[1]);
+  if(argc > 2){
+    for(n = 0; n + 2 < argc && n < MAXCHILD; n++)
+      tickets[n] = atoi(argv[n + 2]);
+  }
+
+  if(pipe(fd) < 0){
+    fprintf(2, "stride: pipe failed\n");
+    exit(1);
+  }
+  old = get_policy();
+  set_policy(SCHED_STRIDE);
+
+  for(i = 0; i < n; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "stride: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      int end;
+
+      close(fd[0]);
+      if(settickets(getpid(), tickets[i]) < 0){
+        fprintf(2, "stride: bad ticket count %d\n", tickets[i]);
+        exit(1);
+      }
+      r.who = i;
+      r.count = 0;
+      end = uptime() + duration;
+      while(uptime() < end){
+        for(int j = 0; j < 1000; j++)
+          r.count++;
+      }
+      write(fd[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fd[1]);
+
+  total = 0;
+  for(i = 0; i < n; i++){
+    if(read(fd[0], &r, sizeof(r)) != sizeof(r) || r.who < 0 || r.who >= n){
+      fprintf(2, "stride: lost a child's result\n");
+      exit(1);
+    }
+    work[r.who] = r.count;
+    total += r.count;
+  }
+  while(wait(0) > 0)
+    ;
+  set_policy(old);
+
+  for(i = 0; i < n; i++){
+    printf("tickets %d: work %d share %d%%\n", tickets[i], (int)(work[i] / 1000),
+           total ? (int)(work[i] * 100 / total) : 0);
+  }
+  exit(0);
+}
@@ -0,0 +1,80 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Show scheduling statistics of the system and of every process.
+//   top               one snapshot
+//   top 10 50         a snapshot every 10 ticks, 50 times
+
+char *policies[] = {
+[SCHED_RR]     "rr",
+[SCHED_SJF]    "sjf",
+[SCHED_FCFS]   "fcfs",
+[SCHED_MLFQ]   "mlfq",
+[SCHED_CFS]    "cfs",
+[SCHED_STRIDE] "stride",
+};
+
+// enum procstate in kernel/proc.h
+char *states[] = { "unused", "used", "sleep", "runble", "run", "zombie" };
+
+void
+show(void)
+{
+  struct sysstats sys;
+  struct procstats p;
+  int i;
+
+  if(getsysstats(&sys) < 0){
+    fprintf(2, "top: getsysstats failed\n");
+    exit(1);
+  }
+
+  printf("ticks %d policy %s procs %d exited %d utilization %d%%\n",
+         (int)sys.ticks, policies[sys.policy], sys.nprocs,
+         (int)sys.number_process, (int)sys.cpu_utilization);
+  printf("means: running %d runnable %d sleeping %d\n",
+         (int)sys.running_time_mean, (int)sys.runnable_time_mean,
+         (int)sys.sleeping_time_mean);
+  for(i = 0; i < NPOLICY; i++){
+    struct policystats *ps = &sys.policies[i];
+    if(ps->active_ticks == 0)
+      continue;
+    printf("  %s: active %d running %d runnable %d sleeping %d exited %d\n",
+           policies[i], (int)ps->active_ticks, (int)ps->running_time,
+           (int)ps->runnable_time, (int)ps->sleeping_time,
+           (int)ps->number_process);
+  }
+
+  printf("pid\tstate\trun\trunble\tsleep\tmean\tnice\tname\n");
+  for(i = 0; i < sys.nprocs; i++){
+    // the process may have gone since the snapshot.
+    if(getprocstats(sys.pids[i], &p) < 0)
+      continue;
+    printf("%d\t%s\t%d\t%d\t%d\t%d\t%d\t%s\n", p.pid, states[p.state],
+           (int)p.total_running_time, (int)p.total_runnable_time,
+           (int)p.total_sleeping_time, (int)p.mean_ticks, p.nice, p.name);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int interval = 0, count = 1;
+
+  if(argc > 1){
+    interval = atoi(argv[1]);
+    count = argc > 2 ? atoi(argv[2]) : 10;
+  }
+
+  for(int i = 0; i < count; i++){
+    if(i > 0){
+      sleep(interval);
+      printf("\n");
+    }
+    show();
+  }
+  exit(0);
+}
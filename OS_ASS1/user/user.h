@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct procstats;
+struct sysstats;
+struct schedhist;
 
 // system calls
 int fork(void);
@@ -26,6 +29,14 @@ int uptime(void);
 int pause_system(int);
 int kill_system(void);
 void print_stats(void);
+int set_policy(int);
+int get_policy(void);
+int setnice(int, int);
+int getnice(int);
+int settickets(int, int);
+int getprocstats(int, struct procstats*);
+int getsysstats(struct sysstats*);
+int getschedhist(int, struct schedhist*);
 
 // ulib.c
 int stat(const char*, struct stat*);
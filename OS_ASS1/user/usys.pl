@@ -39,3 +39,11 @@ entry("uptime");
 entry("pause_system");
 entry("kill_system");
 entry("print_stats");
+entry("set_policy");
+entry("get_policy");
+entry("setnice");
+entry("getnice");
+entry("settickets");
+entry("getprocstats");
+entry("getsysstats");
+entry("getschedhist");
@@ -1,6 +1,7 @@
 struct buf;
 struct context;
 struct file;
+struct kmem_cache;
 struct inode;
 struct pipe;
 struct proc;
@@ -25,6 +26,12 @@ void            consputc(int);
 // exec.c
 int             exec(char*, char**);
 
+// slab.c
+struct kmem_cache* kmem_cache_create(char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+void            kmem_cache_dump(void);
+
 // file.c
 struct file*    filealloc(void);
 void            fileclose(struct file*);
@@ -63,6 +70,10 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kalloc_order(int);
+void            kfree_order(void *, int);
+void            kalloc_test(void);
+void            kmemdump(void);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -72,6 +83,7 @@ void            end_op(void);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
+void            pipeinit(void);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
@@ -107,6 +119,12 @@ void            procdump(void);
 int             set_cpu(int cpu_num);
 int             get_cpu();
 int             cpu_process_count(int cpu_num);
+int             getschedhist(int, uint64);
+int             getproccache(int, uint64);
+int             migration_count(int);
+int             set_affinity(int, int);
+int             get_affinity(int);
+int             set_placement(int);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -115,6 +133,10 @@ void            swtch(struct context*, struct context*);
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initlock_kind(struct spinlock*, char*, int);
+uint64          lockbench(int, int);
+int             lockstat_copyout(uint64, int);
+void            lockdump(void);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
@@ -125,6 +147,10 @@ void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
+// start.c
+int             timer_fired(void);
+void            wakeup_hart(int);
+
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
@@ -1,7 +1,6 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
@@ -11,6 +10,23 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       1000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define CACHELINE     64   // bytes in a cache line
+#define NSLEEPQ       61   // buckets of the sleep queue hash
+#define KCACHE        64   // most free pages cached per CPU
+#define KBATCH        16   // pages moved at once to or from a cache
+#define MAXORDER      10   // largest kalloc_order() block is 2^MAXORDER pages
+
+// Build with KALLOCTEST=ON to self-test the buddy allocator at boot.
+#ifndef KALLOCTEST
+#define KALLOCTEST    0
+#endif
+#define STEAL_MAX      4   // most processes an idle CPU steals at once
+#define STEAL_BACKOFF 16   // most ticks between failed steal attempts
+#define BALANCE_INTERVAL 10  // ticks between load balancing passes
+#define BALANCE_THRESH    2  // imbalance a balancing pass tolerates
+#define BALANCE_HOLD     20  // ticks before a migrated process moves again
+#define PROC_CACHE        8  // free proc slots cached per CPU
+#define PROC_BATCH        4  // slots moved at once to or from a cache
 
 #ifdef numcpus
 #define CPUS numcpus
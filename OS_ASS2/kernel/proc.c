@@ -4,25 +4,36 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "defs.h"
 
 extern uint64 cas(volatile void *addr, int expected, int newval);
 struct proc* remove_head(enum procstate list_type, int cpu_num);
 
-int is_initialize = 0;
-struct proc *zombie_list = 0;
-struct proc *sleeping_list = 0;
-struct proc *unused_list = 0;
-
-struct spinlock ready_list_head_locks[CPUS];
-struct spinlock zombie_list_head_lock;
-struct spinlock sleeping_list_head_lock;
-struct spinlock unused_list_head_lock;
+struct proclist zombie_list;
+struct proclist sleeping_list;
+struct proclist unused_list;
 
 struct cpu cpus[NCPU];
 
+// Placement of processes that become RUNNABLE after fork and
+// sleep. BLNCFLG only picks the one the system boots with.
+int placement = (BLNCFLG)? PLACE_TWO_CHOICES: PLACE_LOCAL;
+
+// Latency histograms of each CPU. Only the CPU itself
+// updates its own, with interrupts off.
+struct schedhist sched_hist[NCPU];
+
 struct proc proc[NPROC];
 
+// Sleep queues: sleeping processes hashed by chan, so that
+// wakeup() only looks at processes whose channels share a
+// bucket with chan. A process puts itself on its queue in
+// sleep() and takes itself off again when it wakes up, so
+// wakeup() and kill() only have to make it RUNNABLE.
+// Lock order: a queue's lock, then p->lock.
+struct sleepq sleepqs[NSLEEPQ];
+
 struct proc *initproc;
 
 int nextpid = 1;
@@ -39,195 +50,251 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-void
-acquire_list(enum procstate list_type, int cpu_num){
-  switch (list_type)
-  {
-  case RUNNABLE:
-    acquire(&ready_list_head_locks[cpu_num]);
-    break;
+struct proclist*
+get_list(enum procstate list_type)
+{
+  switch(list_type){
   case ZOMBIE:
-    acquire(&zombie_list_head_lock);
-    break;
+    return &zombie_list;
   case SLEEPING:
-    acquire(&sleeping_list_head_lock);
-    break;
+    return &sleeping_list;
   case UNUSED:
-    acquire(&unused_list_head_lock);
-    break;
+    return &unused_list;
 
   default:
     panic("list type doesn't exist");
   }
 }
 
-void
-release_list(enum procstate list_type, int cpu_num){
-  switch (list_type)
-  {
-  case RUNNABLE:
-    release(&ready_list_head_locks[cpu_num]);
-    break;
-  case ZOMBIE:
-    release(&zombie_list_head_lock);
-    break;
-  case SLEEPING:
-    release(&sleeping_list_head_lock);
-    break;
-  case UNUSED:
-    release(&unused_list_head_lock);
-    break;
-
-  default:
-    panic("list type doesn't exist");
-  }}
+// Append p to l. Caller must hold l->lock.
+static void
+proclist_push(struct proclist *l, struct proc *p)
+{
+  p->next = 0;
+  p->prev = l->tail;
+  if(l->tail)
+    l->tail->next = p;
+  else
+    l->head = p;
+  l->tail = p;
+}
 
-struct proc* 
-get_head(enum procstate list_type, int cpu_num) {
-  struct proc* p;
-  switch(list_type){
-    case RUNNABLE:
-      p = cpus[cpu_num].runnable_list_head;
-      break;
-    case ZOMBIE:
-      p = zombie_list;
-      break;
-    case SLEEPING:
-      p = sleeping_list;
-      break;
-    case UNUSED:
-      p = unused_list;
-      break;
+// Take the first process off l, or return 0 if it is empty.
+// Caller must hold l->lock.
+static struct proc*
+proclist_pop(struct proclist *l)
+{
+  struct proc *head = l->head;
 
-    default:
-      panic("list type doesn't exist");
+  if(head){
+    l->head = head->next;
+    if(l->head)
+      l->head->prev = 0;
+    else
+      l->tail = 0;
+    head->next = 0;
   }
+  return head;
+}
 
-  return p;
+// Take p off the list of list_type, which it must be on.
+void
+remove_proc_from_list(struct proc *p, enum procstate list_type)
+{
+  struct proclist *l = get_list(list_type);
+
+  acquire(&l->lock);
+  if(p->prev)
+    p->prev->next = p->next;
+  else
+    l->head = p->next;
+  if(p->next)
+    p->next->prev = p->prev;
+  else
+    l->tail = p->prev;
+  p->next = 0;
+  p->prev = 0;
+  release(&l->lock);
 }
 
+// A process was just added to cpu_num's runnable list:
+// if that CPU is idle in wfi, send it a wakeup IPI.
 void
-set_head(struct proc *new_head, enum procstate list_type, int cpu_num){
-  switch (list_type){
-  case RUNNABLE:
-    cpus[cpu_num].runnable_list_head = new_head;
-    break;
-  case ZOMBIE:
-    zombie_list = new_head;
-    break;
-  case SLEEPING:
-    sleeping_list = new_head;
-    break;
-  case UNUSED:
-    unused_list = new_head;
-    break;
+kick_cpu(int cpu_num)
+{
+  __sync_synchronize();
+  if(cpus[cpu_num].idle)
+    wakeup_hart(cpu_num);
+}
 
-  
-  default:
-    panic("list type doesn't exist");
-  }
+// Runnable queues. Slot i of the ring starts out ready for
+// position i. A pusher claims position tail by CAS once its slot
+// is ready for it, stores the process, and then marks the slot
+// ready for pos+1, which is what a popper of that position waits
+// for; the popper claims head by CAS and hands the slot on to
+// position pos+NPROC, the next time round the ring.
+// A CPU pushes to other CPUs' queues on fork and wakeup, and
+// pops from them when stealing, so both ends take many CPUs.
+
+void
+runq_init(struct runq *q)
+{
+  q->head = 0;
+  q->tail = 0;
+  for(uint i = 0; i < NPROC; i++)
+    q->slots[i].seq = i;
 }
 
-int
-remove_proc_from_list(struct proc *p, enum procstate list_type)
+void
+runq_push(struct runq *q, struct proc *p)
 {
-  acquire_list(list_type, p->cpu_num);
-  struct proc *curr = get_head(list_type, p->cpu_num);
-  if(!curr){
-    release_list(list_type, p->cpu_num);
-    return 0;
+  struct runq_slot *s;
+  uint pos;
+
+  for(;;){
+    pos = q->tail;
+    s = &q->slots[pos % NPROC];
+    // Not ready if the slot is still being popped from the last
+    // time round, or another pusher just took pos.
+    if(s->seq == pos && cas(&q->tail, pos, pos + 1) == 0)
+      break;
   }
-  struct proc *prev = 0;
-  if(p == curr){ //p is head
-    acquire(&p->link_lock);
-    set_head(curr->next, list_type, p->cpu_num);
-    p->next = 0;
-    release(&p->link_lock);
-    release_list(list_type, p->cpu_num);
-    return 1;
-  }
-  //p is not head
-  while(curr){
-    acquire(&curr->link_lock);
-    if(p == curr){
-      // acquire(&prev->link_lock);
-      // if(!prev){
-      //   release_list(list_type, p->cpu_num); //todo
-      // }
-      prev->next = curr->next;
-      curr->next = 0;
-      release(&curr->link_lock);
-      release(&prev->link_lock);
-      return 1; 
-    }
-      if(!prev){
-        release_list(list_type, p->cpu_num); //todo
-      }
-      else{
-        release(&prev->link_lock);
-      }
+  s->proc = p;
+  __sync_synchronize();
+  s->seq = pos + 1;
+}
 
-      prev = curr;
-      curr = curr->next;
-    
+// Returns 0 if the queue is empty, or its only processes are
+// still being pushed.
+struct proc*
+runq_pop(struct runq *q)
+{
+  struct runq_slot *s;
+  struct proc *p;
+  uint pos;
+
+  for(;;){
+    pos = q->head;
+    s = &q->slots[pos % NPROC];
+    if(s->seq != pos + 1){
+      if(pos == q->head)
+        return 0;
+      continue;
+    }
+    if(cas(&q->head, pos, pos + 1) == 0)
+      break;
   }
-  return 0;
+  __sync_synchronize();
+  p = s->proc;
+  __sync_synchronize();
+  s->seq = pos + NPROC;
+  return p;
 }
 
+// Number of processes on q; may be stale by the time it returns.
+// Reads head before tail, so pops racing with the reads can only
+// make the count too large, never wrap it below zero; clamp it to
+// what the ring can hold.
 int
+runq_len(struct runq *q)
+{
+  uint head, tail;
+  int n;
+
+  head = q->head;
+  __sync_synchronize();
+  tail = q->tail;
+  n = (int)(tail - head);
+  if(n < 0)
+    return 0;
+  if(n > NPROC)
+    return NPROC;
+  return n;
+}
+
+// Append p to the list of list_type. cpu_num picks the
+// runnable queue, and is ignored for the other states.
+void
 add_proc_to_list(struct proc *p, enum procstate list_type, int cpu_num)
 {
-  struct proc *curr = 0;
-  acquire_list(list_type, cpu_num);
-  curr = get_head(list_type, cpu_num);
-  if(!curr){ //empty list
-    set_head(p, list_type, cpu_num);
-    release_list(list_type, cpu_num);
-    return 1;
-  }
-  struct proc *prev = 0;
-  while(curr){
-    acquire(&curr->link_lock);
-    if(prev){
-      release(&prev->link_lock);
-    }
-    else{
-      release_list(list_type, cpu_num);
-    }
-    prev = curr;
-    curr = curr->next;
-    // release(&prev->link_lock);
+  struct proclist *l;
+
+  if(list_type == RUNNABLE){
+    p->runnable_cycles = r_time();
+    runq_push(&cpus[cpu_num].runq, p);
+    kick_cpu(cpu_num);
+    return;
   }
-  // acquire(&prev->link_lock);
-  prev->next = p;
-  release(&prev->link_lock);
-  // release_list(list_type, cpu_num);
-  return 1;
+  l = get_list(list_type);
+  acquire(&l->lock);
+  proclist_push(l, p);
+  release(&l->lock);
 }
 
+// Load counters of each CPU. A CPU's counter is kept in parts,
+// one per CPU that changes it: CPU i only adds to row i, with
+// interrupts off and no atomics, and a reader sums the column.
+// Rows sit on cache lines of their own, so counting on one CPU
+// never pulls a line away from another.
+struct cpucounts {
+  uint64 runnable[NCPU];       // RUNNABLE or RUNNING processes of a CPU
+  uint64 admitted[NCPU];       // Processes ever placed on a CPU
+  uint64 migrated_in[NCPU];    // Processes stolen or balanced onto a CPU
+} __attribute__((aligned(CACHELINE)));
+
+struct cpucounts cpucounts[NCPU];
+
 void increase_admitted_process_count(int cpu_num){
-  struct cpu* c = &cpus[cpu_num];
-  uint64 old;
-  do{
-    old = c->admitted_process_count;
-  } while(cas(&c->admitted_process_count, old, old+1));
+  push_off();
+  cpucounts[cpuid()].admitted[cpu_num]++;
+  pop_off();
 }
+
 void
 decrease_runnable_list_size_of(int cpu_num){
-  struct cpu* c = &cpus[cpu_num];
-  uint64 old;
-  do{
-    old = c->proc_list_size;
-  } while(cas(&c->proc_list_size, old, old-1));
+  push_off();
+  cpucounts[cpuid()].runnable[cpu_num]--;
+  pop_off();
+}
+
+void
+increase_migrated_in_of(int cpu_num){
+  push_off();
+  cpucounts[cpuid()].migrated_in[cpu_num]++;
+  pop_off();
 }
 
 void
 increase_runnable_list_size_of(int cpu_num){
-  struct cpu* c = &cpus[cpu_num];
-  uint64 old;
-  do{
-    old = c->proc_list_size;
-  } while(cas(&c->proc_list_size, old, old+1));
+  push_off();
+  cpucounts[cpuid()].runnable[cpu_num]++;
+  pop_off();
+}
+
+// The counters of cpu_num, summed over all rows. Unlocked, so
+// they may be a little behind updates on other CPUs.
+int
+runnable_list_size_of(int cpu_num){
+  uint64 n = 0;
+  for(int i = 0; i < CPUS; i++)
+    n += cpucounts[i].runnable[cpu_num];
+  return n;
+}
+
+int
+admitted_process_count_of(int cpu_num){
+  uint64 n = 0;
+  for(int i = 0; i < CPUS; i++)
+    n += cpucounts[i].admitted[cpu_num];
+  return n;
+}
+
+int
+migrated_in_of(int cpu_num){
+  uint64 n = 0;
+  for(int i = 0; i < CPUS; i++)
+    n += cpucounts[i].migrated_in[cpu_num];
+  return n;
 }
 
 // Allocate a page for each process's kernel stack.
@@ -254,20 +321,21 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
-  initlock(&zombie_list_head_lock, "zombie_list_head_lock");
-  initlock(&sleeping_list_head_lock, "sleeping_list_head_lock");
-  initlock(&unused_list_head_lock, "unused_list_head_lock");
-
-  struct spinlock* sl;
-  for(sl = ready_list_head_locks; sl <&ready_list_head_locks[CPUS]; sl++){
-    initlock(sl, "ready_list_head_locks");
+  for(int i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepqs[i].lock, "sleepq");
+  initlock_kind(&zombie_list.lock, "zombie_list", LOCK_TICKET);
+  initlock_kind(&sleeping_list.lock, "sleeping_list", LOCK_TICKET);
+  initlock_kind(&unused_list.lock, "unused_list", LOCK_TICKET);
+
+  struct cpu* c;
+  for(c = cpus; c < &cpus[CPUS]; c++){
+    runq_init(&c->runq);
+    initlock(&c->free_lock, "proc_cache");
   }
 
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
-      initlock(&p->link_lock, "link_lock");
       p->cpu_num = -1;
-      p->next = 0;
       p->kstack = KSTACK((int) (p - proc));
       add_proc_to_list(p, UNUSED, 0);
   }
@@ -313,6 +381,66 @@ allocpid() {
   return pid;
 }
 
+// Per-CPU caches of free proc slots, so that fork() and wait()
+// on different CPUs mostly don't meet on unused_list. A cache
+// refills from unused_list, and spills back to it, PROC_BATCH
+// slots at a time under one hold of its lock. Only a CPU that
+// finds its cache and unused_list both empty looks at the other
+// CPUs' caches. Lock order: free_lock, then unused_list.lock.
+
+static struct proc*
+alloc_proc_slot(void)
+{
+  struct cpu *c;
+  struct proc *p = 0;
+
+  push_off();
+  c = mycpu();
+  acquire(&c->free_lock);
+  if(c->nfree > 0){
+    c->free_hits++;
+  } else {
+    c->free_misses++;
+    acquire(&unused_list.lock);
+    while(c->nfree < PROC_BATCH && (p = proclist_pop(&unused_list)) != 0)
+      c->free_procs[c->nfree++] = p;
+    release(&unused_list.lock);
+  }
+  p = c->nfree > 0 ? c->free_procs[--c->nfree] : 0;
+  release(&c->free_lock);
+
+  for(int i = 0; p == 0 && i < CPUS; i++){
+    if(&cpus[i] == c)
+      continue;
+    acquire(&cpus[i].free_lock);
+    if(cpus[i].nfree > 0)
+      p = cpus[i].free_procs[--cpus[i].nfree];
+    release(&cpus[i].free_lock);
+  }
+  pop_off();
+  return p;
+}
+
+static void
+free_proc_slot(struct proc *p)
+{
+  struct cpu *c;
+
+  push_off();
+  c = mycpu();
+  acquire(&c->free_lock);
+  if(c->nfree == PROC_CACHE){
+    c->free_spills++;
+    acquire(&unused_list.lock);
+    while(c->nfree > PROC_CACHE - PROC_BATCH)
+      proclist_push(&unused_list, c->free_procs[--c->nfree]);
+    release(&unused_list.lock);
+  }
+  c->free_procs[c->nfree++] = p;
+  release(&c->free_lock);
+  pop_off();
+}
+
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
@@ -321,7 +449,7 @@ static struct proc*
 allocproc(void)
 {
   struct proc *p;
-  p = remove_head(UNUSED, 0);
+  p = alloc_proc_slot();
   if(!p){
     return 0;
   }
@@ -332,6 +460,8 @@ allocproc(void)
 found:
   p->pid = allocpid();
   p->state = USED;
+  p->migrate_tick = 0;
+  p->affinity = CPU_MASK_ALL;
   p->next = 0;
 
   // Allocate a trapframe page.
@@ -377,10 +507,11 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
-  remove_proc_from_list(p, ZOMBIE);
+  // allocproc() and fork() also free procs that never ran.
+  if(p->state == ZOMBIE)
+    remove_proc_from_list(p, ZOMBIE);
   p->state = UNUSED;
-  add_proc_to_list(p, UNUSED, 0);
-
+  free_proc_slot(p);
 }
 
 // Create a user page table for a given process,
@@ -442,16 +573,6 @@ uchar initcode[] = {
 void
 userinit(void)
 {
-  if(!is_initialize){
-    struct cpu* c;
-    for(c = cpus; c < &cpus[CPUS]; c++){
-      c->runnable_list_head = 0;
-      c->proc_list_size = 0;
-      c->admitted_process_count = 0;
-    }
-    is_initialize = 1;
-  }
-
   struct proc *p;
 
   p = allocproc();
@@ -473,7 +594,6 @@ userinit(void)
   p->cpu_num = 0;
   add_proc_to_list(p, RUNNABLE, p->cpu_num);
   increase_runnable_list_size_of(p->cpu_num);
-  set_head(p, RUNNABLE, p->cpu_num);
 
   release(&p->lock);
 }
@@ -498,18 +618,118 @@ growproc(int n)
   return 0;
 }
 
+// The least used of the CPUs in affinity mask, which must
+// not be empty.
 int
-find_least_used_cpu()
+find_least_used_cpu(int mask)
 {
-  int least_used_cpu_num = 0;
-  for(int i = 1; i<CPUS; i++){
-    if(cpus[i].admitted_process_count < cpus[least_used_cpu_num].admitted_process_count){
+  int least_used_cpu_num = -1;
+  for(int i = 0; i<CPUS; i++){
+    if(!(mask & (1 << i)))
+      continue;
+    if(least_used_cpu_num < 0 ||
+       admitted_process_count_of(i) < admitted_process_count_of(least_used_cpu_num)){
       least_used_cpu_num = i;
     }
   }
   return least_used_cpu_num;
 }
 
+// A random number from this CPU's generator.
+static uint
+cpu_rand(void)
+{
+  struct cpu *c;
+  uint r;
+
+  push_off();
+  c = mycpu();
+  c->rand_seed = c->rand_seed * 1103515245 + 12345;
+  r = c->rand_seed >> 16;
+  pop_off();
+  return r;
+}
+
+// Live load of CPU i: the processes waiting on its runnable
+// queue and the one it is running.
+static int
+cpu_load(int i)
+{
+  return runq_len(&cpus[i].runq) + (cpus[i].proc != 0);
+}
+
+// Power of two choices: the less loaded of two different CPUs
+// picked at random from mask, which must not be empty. Nearly
+// as even as looking at every CPU, at the cost of two peeks.
+static int
+two_choices(int mask)
+{
+  int allowed[NCPU];
+  int n = 0, a, b;
+
+  for(int i = 0; i < CPUS; i++){
+    if(mask & (1 << i))
+      allowed[n++] = i;
+  }
+  if(n == 1)
+    return allowed[0];
+  a = cpu_rand() % n;
+  b = (a + 1 + cpu_rand() % (n - 1)) % n;
+  return cpu_load(allowed[b]) < cpu_load(allowed[a]) ? allowed[b] : allowed[a];
+}
+
+// The CPU p should be queued on: cpu_num if p's affinity
+// allows it, or else one that it allows.
+static int
+allowed_cpu(struct proc *p, int cpu_num)
+{
+  if(p->affinity & (1 << cpu_num))
+    return cpu_num;
+  return two_choices(p->affinity);
+}
+
+// The CPU to queue p on as it becomes RUNNABLE after fork or
+// sleep; cpu_num is the CPU it (or its parent) ran on last.
+static int
+place_cpu(struct proc *p, int cpu_num)
+{
+  switch(placement){
+  case PLACE_LEAST_USED:
+    return find_least_used_cpu(p->affinity);
+  case PLACE_TWO_CHOICES:
+    return two_choices(p->affinity);
+  default:
+    return allowed_cpu(p, cpu_num);
+  }
+}
+
+// Put child c on the list *l of its parent's children or zombies.
+// Caller must hold wait_lock.
+static void
+child_link(struct proc **l, struct proc *c)
+{
+  c->sibling_prev = 0;
+  c->sibling_next = *l;
+  if(*l)
+    (*l)->sibling_prev = c;
+  *l = c;
+}
+
+// Take child c off the list *l it is on.
+// Caller must hold wait_lock.
+static void
+child_unlink(struct proc **l, struct proc *c)
+{
+  if(c->sibling_prev)
+    c->sibling_prev->sibling_next = c->sibling_next;
+  else
+    *l = c->sibling_next;
+  if(c->sibling_next)
+    c->sibling_next->sibling_prev = c->sibling_prev;
+  c->sibling_next = 0;
+  c->sibling_prev = 0;
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 int
@@ -545,6 +765,7 @@ fork(void)
   np->cwd = idup(p->cwd);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
+  np->affinity = p->affinity;
 
   pid = np->pid;
 
@@ -552,15 +773,15 @@ fork(void)
 
   acquire(&wait_lock);
   np->parent = p;
+  child_link(&p->children, np);
   release(&wait_lock);
 
   acquire(&np->lock);
   np->state = RUNNABLE;
-  int cpu_num = (BLNCFLG)? find_least_used_cpu(): p->cpu_num;
+  int cpu_num = place_cpu(np, p->cpu_num);
   np->cpu_num = cpu_num;
   add_proc_to_list(np, RUNNABLE, cpu_num);
   increase_admitted_process_count(cpu_num);
-  cpus[cpu_num].admitted_process_count ++;
   increase_runnable_list_size_of(cpu_num);
   release(&np->lock);
 
@@ -574,11 +795,18 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
+  while((pp = p->children) != 0){
+    child_unlink(&p->children, pp);
+    pp->parent = initproc;
+    child_link(&initproc->children, pp);
+  }
+  if(p->zombies){
+    while((pp = p->zombies) != 0){
+      child_unlink(&p->zombies, pp);
       pp->parent = initproc;
-      wakeup(initproc);
+      child_link(&initproc->zombies, pp);
     }
+    wakeup(initproc);
   }
 }
 
@@ -619,6 +847,10 @@ exit(int status)
 
   p->xstate = status;
   p->state = ZOMBIE;
+
+  // Ready for the parent's wait() to reap.
+  child_unlink(&p->parent->children, p);
+  child_link(&p->parent->zombies, p);
   add_proc_to_list(p, ZOMBIE, 0);
   decrease_runnable_list_size_of(p->cpu_num);
 
@@ -635,42 +867,34 @@ int
 wait(uint64 addr)
 {
   struct proc *np;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
-          release(&np->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    // Any exited child will do.
+    np = p->zombies;
+    if(np){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      pid = np->pid;
+      if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                              sizeof(np->xstate)) < 0) {
         release(&np->lock);
+        release(&wait_lock);
+        return -1;
       }
+      child_unlink(&p->zombies, np);
+      freeproc(np);
+      release(&np->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || p->killed){
+    if(p->children == 0 || p->killed){
       release(&wait_lock);
-      extern uint64 cas(volatile void *addr, int expected, int newval);
       return -1;
     }
     
@@ -679,73 +903,228 @@ wait(uint64 addr)
   }
 }
 
+// Take the first process off the list of list_type, or
+// cpu_num's runnable queue. Returns 0 if it is empty.
 struct proc* 
 remove_head(enum procstate list_type, int cpu_num)
 {
-  acquire_list(list_type, cpu_num);
-  struct proc* head = get_head(list_type, cpu_num);
-  if(!head){
-    release_list(list_type, cpu_num);
-  }
-  else{
-    acquire(&head->link_lock);
-    set_head(head->next, list_type, cpu_num);
-    head->next = 0;
-    release(&head->link_lock);
-    release_list(list_type, cpu_num);
-  }
+  struct proclist *l;
+  struct proc *head;
+
+  if(list_type == RUNNABLE)
+    return runq_pop(&cpus[cpu_num].runq);
+  l = get_list(list_type);
+  acquire(&l->lock);
+  head = proclist_pop(l);
+  release(&l->lock);
   return head;
-  // printf("r_h before ac\n");
-  // acquire_list(list_type, cpu_num);
-  // printf("r_h after ac\n");
-  // struct proc *head = get_head(list_type, cpu_num);
-  // printf("r_h before rel\n");
-  // release_list(list_type, cpu_num);
-  // printf("r_h after rel\n");
-  // printf("NEVO NEVO NEVO NEVO NEVO NEVO NEVO NEVO \n");
-  // printf("%s\n",head->name);
-  // printf("%d\n", is_initialize);
-  // remove_proc_from_list(head, list_type);
-  // return head;
-}
-
-struct proc* steal_process(){
-  struct proc *res = 0;
+}
+
+// Hand p, just taken off from's runnable queue, over to CPU to.
+// Caller must hold p->lock.
+static void
+migrate_proc(struct proc *p, int from, int to)
+{
+  p->cpu_num = to;
+  p->migrate_tick = ticks;
+  decrease_runnable_list_size_of(from);
+  increase_runnable_list_size_of(to);
+  increase_admitted_process_count(to);
+  increase_migrated_in_of(to);
+}
+
+// Pick a CPU to steal from: the one with the most processes,
+// looking from a random place so that thieves spread out over
+// equally loaded victims. Returns -1 if no other CPU has a
+// runnable process queued. Peeks at the lists without locks.
+static int
+pick_victim(int my_cpu_num)
+{
+  int victim = -1, start, i;
+
+  start = cpu_rand() % CPUS;
+  for(int k = 0; k < CPUS; k++){
+    i = (start + k) % CPUS;
+    if(i == my_cpu_num || runq_len(&cpus[i].runq) == 0)
+      continue;
+    if(victim < 0 || runnable_list_size_of(i) > runnable_list_size_of(victim))
+      victim = i;
+  }
+  return victim;
+}
+
+// This CPU's runnable list is empty: take half of the processes
+// queued on the busiest CPU, at most STEAL_MAX, stopping at one
+// whose affinity does not allow this CPU. The first one is
+// returned for the caller to run, the rest go on this CPU's list.
+// If there is nothing to take, wait twice as long as last time,
+// up to STEAL_BACKOFF ticks, before trying again.
+struct proc*
+steal_process(struct cpu *c)
+{
+  struct proc *p, *res = 0;
   int my_cpu_num = cpuid();
-  for(int i = 0; i<CPUS; i++){
-    if(my_cpu_num != i){
-      res = remove_head(RUNNABLE,i);
-      if(res){
-        acquire(&res->link_lock);
-        res->cpu_num = my_cpu_num;
-        release(&res->link_lock);
-        decrease_runnable_list_size_of(i);
-        increase_admitted_process_count(my_cpu_num);
+  int victim, n;
+  uint64 since;
+
+  if(ticks < c->next_steal)
+    return 0;
+  victim = pick_victim(my_cpu_num);
+  if(victim >= 0){
+    // the count includes the process victim is running.
+    n = runnable_list_size_of(victim) / 2;
+    if(n < 1)
+      n = 1;
+    if(n > STEAL_MAX)
+      n = STEAL_MAX;
+    // Once off victim's list, p is RUNNABLE on no list at all,
+    // so nobody else can pick it or change its cpu_num.
+    while(n-- > 0 && (p = remove_head(RUNNABLE, victim)) != 0){
+      acquire(&p->lock);
+      if(!(p->affinity & (1 << my_cpu_num))){
+        // not allowed here; back where it was.
+        since = p->runnable_cycles;
+        add_proc_to_list(p, RUNNABLE, victim);
+        p->runnable_cycles = since;
+        release(&p->lock);
         break;
       }
+      migrate_proc(p, victim, my_cpu_num);
+      if(res == 0){
+        res = p;
+      } else {
+        // still waiting since it became RUNNABLE, not since now.
+        since = p->runnable_cycles;
+        add_proc_to_list(p, RUNNABLE, my_cpu_num);
+        p->runnable_cycles = since;
+      }
+      release(&p->lock);
     }
   }
+
+  if(res){
+    c->steal_backoff = 0;
+  } else {
+    c->steal_backoff = c->steal_backoff ? c->steal_backoff * 2 : 1;
+    if(c->steal_backoff > STEAL_BACKOFF)
+      c->steal_backoff = STEAL_BACKOFF;
+    c->next_steal = ticks + c->steal_backoff;
+  }
   return res;
 }
+
+// Periodic load balancing: every BALANCE_INTERVAL ticks, pull
+// processes from the busiest CPU until both have about as many.
+// Only when they are more than BALANCE_THRESH apart, and never
+// a process that moved in the last BALANCE_HOLD ticks, so that
+// processes don't bounce back and forth between CPUs.
+static void
+balance(struct cpu *c)
+{
+  struct proc *p;
+  int my_cpu_num = cpuid();
+  int busiest = -1, mine, theirs, n;
+  uint64 since;
+
+  if(ticks < c->next_balance)
+    return;
+  c->next_balance = ticks + BALANCE_INTERVAL;
+
+  for(int i = 0; i < CPUS; i++){
+    if(i == my_cpu_num)
+      continue;
+    if(busiest < 0 || runnable_list_size_of(i) > runnable_list_size_of(busiest))
+      busiest = i;
+  }
+  if(busiest < 0)
+    return;
+  mine = runnable_list_size_of(my_cpu_num);
+  theirs = runnable_list_size_of(busiest);
+  if(theirs - mine <= BALANCE_THRESH)
+    return;
+
+  for(n = (theirs - mine) / 2; n > 0; n--){
+    if((p = remove_head(RUNNABLE, busiest)) == 0)
+      break;
+    acquire(&p->lock);
+    since = p->runnable_cycles;
+    if(!(p->affinity & (1 << my_cpu_num)) ||
+       (p->migrate_tick && ticks - p->migrate_tick < BALANCE_HOLD)){
+      // not allowed here, or moved too recently;
+      // back where it was, and try next time.
+      add_proc_to_list(p, RUNNABLE, busiest);
+      p->runnable_cycles = since;
+      release(&p->lock);
+      break;
+    }
+    migrate_proc(p, busiest, my_cpu_num);
+    add_proc_to_list(p, RUNNABLE, my_cpu_num);
+    p->runnable_cycles = since;
+    release(&p->lock);
+  }
+}
+
+// Histogram bucket of an interval of n time CSR cycles.
+static int
+hist_bucket(uint64 n)
+{
+  int b = 0;
+
+  while(n > 1 && b < NHIST - 1){
+    n >>= 1;
+    b++;
+  }
+  return b;
+}
+
+// This CPU's runnable list is empty: sleep in wfi until a
+// device interrupt, the timer, or a wakeup IPI from kick_cpu().
+// c->idle is published before the last look at the list, and
+// interrupts stay off from there until wfi, which wakes on a
+// pending interrupt all the same. So a process added meanwhile
+// is either seen here, or its IPI ends the wfi.
+static void
+idle(struct cpu *c)
+{
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  if(runq_len(&c->runq) == 0)
+    wfi();
+  c->idle = 0;
+  intr_on();
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - if BLNCFLG is on, now and then even out the load
+//    with the busiest CPU.
+//  - choose a process to run, stealing one from
+//    another CPU if BLNCFLG is on and our list is empty.
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
+//  - if there was nothing to run, idle in wfi.
 void
 scheduler(void)
 {
   struct cpu *c = mycpu();
+  struct schedhist *h = &sched_hist[cpuid()];
   struct proc *curr; 
+  uint64 start;
   c->proc=0;
+  c->rand_seed = r_time() + cpuid();
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
+    if(BLNCFLG)
+      balance(c);
     curr = remove_head(RUNNABLE, cpuid());
+    if(!curr && BLNCFLG)
+      curr = steal_process(c);
     if(!curr){
-      // curr = steal_process();
+      idle(c);
       continue;
     }
     acquire(&curr->lock);
@@ -754,9 +1133,13 @@ scheduler(void)
       panic("proc is not RUNNABLE");
     }
     curr->state = RUNNING;
+    start = r_time();
+    h->latency[hist_bucket(start - curr->runnable_cycles)]++;
+    h->switches++;
     c->proc = curr;
     swtch(&c->context, &curr->context);
     c->proc = 0;
+    h->slice[hist_bucket(r_time() - start)]++;
     release(&curr->lock);
   }
 }
@@ -795,6 +1178,13 @@ yield(void)
   struct proc *p = myproc();
   acquire(&p->lock);
   p->state = RUNNABLE;
+  int cpu_num = allowed_cpu(p, p->cpu_num);
+  if(cpu_num != p->cpu_num){
+    // our affinity has changed.
+    decrease_runnable_list_size_of(p->cpu_num);
+    increase_runnable_list_size_of(cpu_num);
+    p->cpu_num = cpu_num;
+  }
   add_proc_to_list(p, RUNNABLE, p->cpu_num);
   sched();
   release(&p->lock);
@@ -821,38 +1211,61 @@ forkret(void)
   usertrapret();
 }
 
+// The sleep queue of chan, see sleepqs.
+static struct sleepq*
+sleepq_of(void *chan)
+{
+  return &sleepqs[((uint64)chan >> 3) % NSLEEPQ];
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *q = sleepq_of(chan);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
-  // so it's okay to release lk.
+  // Once we are on chan's sleep queue and hold
+  // p->lock, we can be guaranteed that we won't
+  // miss any wakeup (wakeup locks the queue and
+  // then p->lock), so it's okay to release lk.
 
+  acquire(&q->lock);
   acquire(&p->lock);  //DOC: sleeplock1
-  
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
   decrease_runnable_list_size_of(p->cpu_num);
   add_proc_to_list(p, SLEEPING, 0);
-  
+  p->sq_prev = 0;
+  p->sq_next = q->head;
+  if(q->head)
+    q->head->sq_prev = p;
+  q->head = p;
+  release(&q->lock);
   release(lk);
 
   sched();
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  // Until we are off the queue, wakeup() skips us for our chan.
+  acquire(&q->lock);
+  if(p->sq_prev)
+    p->sq_prev->sq_next = p->sq_next;
+  else
+    q->head = p->sq_next;
+  if(p->sq_next)
+    p->sq_next->sq_prev = p->sq_prev;
+  release(&q->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
@@ -861,22 +1274,28 @@ sleep(void *chan, struct spinlock *lk)
 void
 wakeup(void *chan)
 {
+  struct sleepq *q = sleepq_of(chan);
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        remove_proc_from_list(p, SLEEPING);
-        p->state = RUNNABLE;
-        int cpu_num = (BLNCFLG)? find_least_used_cpu(): p->cpu_num; 
-        add_proc_to_list(p, RUNNABLE, cpu_num);
-        increase_admitted_process_count(cpu_num);
-        increase_runnable_list_size_of(cpu_num);
-      }
-      release(&p->lock);
+  acquire(&q->lock);
+  for(p = q->head; p; p = p->sq_next){
+    // Only a process that is no longer asleep changes its chan
+    // without q->lock, so others' channels can be skipped unlocked.
+    if(p->chan != chan)
+      continue;
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan) {
+      remove_proc_from_list(p, SLEEPING);
+      p->state = RUNNABLE;
+      int cpu_num = place_cpu(p, p->cpu_num);
+      p->cpu_num = cpu_num;
+      add_proc_to_list(p, RUNNABLE, cpu_num);
+      increase_admitted_process_count(cpu_num);
+      increase_runnable_list_size_of(cpu_num);
     }
+    release(&p->lock);
   }
+  release(&q->lock);
 }
 
 // Kill the process with the given pid.
@@ -895,6 +1314,7 @@ kill(int pid)
         remove_proc_from_list(p, SLEEPING);
         // Wake process from sleep().
         p->state = RUNNABLE;
+        p->cpu_num = allowed_cpu(p, p->cpu_num);
         add_proc_to_list(p, RUNNABLE, p->cpu_num);
         increase_runnable_list_size_of(p->cpu_num);
       }
@@ -963,6 +1383,16 @@ procdump(void)
     printf("%d %s %s", p->pid, state, p->name);
     printf("\n");
   }
+  for(int i = 0; i < CPUS; i++){
+    struct cpu *c = &cpus[i];
+    uint64 allocs = c->free_hits + c->free_misses;
+    printf("cpu %d: proc cache %d free, %d hits of %d (%d%%), %d spills\n",
+           i, c->nfree, (int)c->free_hits, (int)allocs,
+           allocs ? (int)(c->free_hits * 100 / allocs) : 0, (int)c->free_spills);
+  }
+  kmemdump();
+  kmem_cache_dump();
+  lockdump();
 }
 
 
@@ -976,20 +1406,20 @@ range_check(int num, int min, int max)
 }
 
 
+// Pin the current process to cpu_num.
 int 
 set_cpu(int cpu_num)
 {
-  if(range_check(cpu_num,0,NCPU)<0){
+  struct proc *p = myproc();
+
+  if(range_check(cpu_num,0,CPUS-1)<0){
     return -1;
   }
-  //remove proccess from current cpu runnable list
-  decrease_runnable_list_size_of(myproc()->cpu_num);
-  //set process's cpu num to new cpu runnable list
-  myproc()->cpu_num = cpu_num;
-  //increase new cpu runnable list
-  increase_runnable_list_size_of(cpu_num);
-  //process won’t keep running on the current CPU
-  //as it no longer belong to its list
+  acquire(&p->lock);
+  p->affinity = 1 << cpu_num;
+  release(&p->lock);
+  //process won’t keep running on the current CPU:
+  //yield() puts it on cpu_num's runnable list
   yield();
   return cpu_num;
 }
@@ -1000,6 +1430,130 @@ get_cpu()
   return myproc()->cpu_num;
 }
 
+// Let the process with the given pid, or the current process
+// if pid is 0, run only on the CPUs in mask. It moves when it
+// next becomes RUNNABLE; the current process moves right away
+// if it is on a CPU no longer allowed.
+int
+set_affinity(int pid, int mask)
+{
+  struct proc *p, *me = myproc();
+
+  mask &= CPU_MASK_ALL;
+  if(mask == 0)
+    return -1;
+  if(pid == 0)
+    pid = me->pid;
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      p->affinity = mask;
+      release(&p->lock);
+      if(p == me && !(mask & (1 << p->cpu_num)))
+        yield();
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// The affinity mask of the process with the given pid, or of
+// the current process if pid is 0.
+int
+get_affinity(int pid)
+{
+  struct proc *p;
+  int mask;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      mask = p->affinity;
+      release(&p->lock);
+      return mask;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Switch fork() and wakeup() to placement policy how, one of
+// PLACE_* in sched.h. Returns the previous one.
+int
+set_placement(int how)
+{
+  int old = placement;
+
+  if(how < PLACE_LOCAL || how > PLACE_TWO_CHOICES)
+    return -1;
+  placement = how;
+  return old;
+}
+
 int cpu_process_count(int cpu_num){
-  return cpus[cpu_num].admitted_process_count;
+  if(range_check(cpu_num, 0, CPUS-1) < 0)
+    return -1;
+  return admitted_process_count_of(cpu_num);
+}
+
+// Processes moved onto cpu_num by stealing and load balancing,
+// or onto any CPU if cpu_num is -1.
+int
+migration_count(int cpu_num)
+{
+  int n = 0;
+
+  if(cpu_num != -1 && range_check(cpu_num, 0, CPUS-1) < 0)
+    return -1;
+  for(int i = 0; i < CPUS; i++){
+    if(cpu_num == -1 || i == cpu_num)
+      n += migrated_in_of(i);
+  }
+  return n;
+}
+
+// Copy the latency histograms of cpu_num, or summed over all
+// CPUs if cpu_num is -1, out to user address addr.
+int
+getschedhist(int cpu_num, uint64 addr)
+{
+  struct schedhist st;
+
+  if(cpu_num != -1 && range_check(cpu_num, 0, CPUS-1) < 0)
+    return -1;
+  memset(&st, 0, sizeof(st));
+  for(int i = 0; i < CPUS; i++){
+    if(cpu_num != -1 && i != cpu_num)
+      continue;
+    for(int b = 0; b < NHIST; b++){
+      st.latency[b] += sched_hist[i].latency[b];
+      st.slice[b] += sched_hist[i].slice[b];
+    }
+    st.switches += sched_hist[i].switches;
+  }
+  return copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st));
+}
+
+// Copy the proc slot cache statistics of cpu_num, or summed over
+// all CPUs if cpu_num is -1, out to user address addr.
+int
+getproccache(int cpu_num, uint64 addr)
+{
+  struct proccache st;
+
+  if(cpu_num != -1 && range_check(cpu_num, 0, CPUS-1) < 0)
+    return -1;
+  memset(&st, 0, sizeof(st));
+  for(int i = 0; i < CPUS; i++){
+    if(cpu_num != -1 && i != cpu_num)
+      continue;
+    st.hits += cpus[i].free_hits;
+    st.misses += cpus[i].free_misses;
+    st.spills += cpus[i].free_spills;
+    st.nfree += cpus[i].nfree;
+  }
+  return copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st));
 }
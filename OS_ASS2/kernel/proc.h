@@ -5,6 +5,9 @@
 #define BLNCFLG OFF
 #endif
 
+// Affinity mask of a process allowed on every CPU.
+#define CPU_MASK_ALL ((1 << CPUS) - 1)
+
 // Saved registers for kernel context switches.
 struct context {
   uint64 ra;
@@ -25,16 +28,43 @@ struct context {
   uint64 s11;
 };
 
-// Per-CPU state.
+// Runnable queue of one CPU: a bounded FIFO ring that every CPU
+// may push to and pop from without locks, see runq_push() in
+// proc.c. It never holds more than the NPROC processes there are.
+struct runq_slot {
+  volatile uint seq;          // Ring position this slot is ready for
+  struct proc *proc;
+};
+
+struct runq {
+  volatile uint head;         // Next position to pop
+  // poppers and pushers each get a cache line of their own.
+  volatile uint tail __attribute__((aligned(CACHELINE)));  // Next position to push
+  struct runq_slot slots[NPROC] __attribute__((aligned(CACHELINE)));
+};
+
+// Per-CPU state, on cache lines of its own. The load counters
+// other CPUs update are in cpucounts[] in proc.c.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
-  struct proc *runnable_list_head;
-  uint64 proc_list_size;
-  uint64 admitted_process_count;
-};
+  struct runq runq;           // RUNNABLE processes waiting for this CPU
+  volatile int idle;          // In wfi, waiting for work? See idle().
+  uint rand_seed;             // Random state, see cpu_rand()
+  uint steal_backoff;         // Ticks to wait after a failed steal
+  uint next_steal;            // Don't try to steal before this tick
+  uint next_balance;          // Tick of the next load balancing pass
+
+  // Free proc slots, see alloc_proc_slot(); free_lock must be held.
+  struct spinlock free_lock;
+  struct proc *free_procs[PROC_CACHE];
+  int nfree;
+  uint64 free_hits;           // allocproc()s served from the cache
+  uint64 free_misses;         // ... that had to go to unused_list
+  uint64 free_spills;         // freeproc()s that found the cache full
+} __attribute__((aligned(CACHELINE)));
 
 extern struct cpu cpus[NCPU];
 
@@ -95,7 +125,6 @@ enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 // Per-process state
 struct proc {
   struct spinlock lock;
-  struct spinlock link_lock;
 
   // p->lock must be held when using these:
   enum procstate state;        // Process state
@@ -103,9 +132,18 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
-  struct proc *next;
+  struct proc *next;           // Neighbours on the list of p's state
+  struct proc *prev;
+  // the lock of chan's sleep queue must be held when using these:
+  struct proc *sq_next;        // Other processes on the same sleep queue
+  struct proc *sq_prev;
+
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
+  struct proc *children;       // Children that have not exited
+  struct proc *zombies;        // Children that have exited, not yet waited for
+  struct proc *sibling_next;   // Next and previous on parent's children
+  struct proc *sibling_prev;   // or zombies list
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
@@ -117,4 +155,23 @@ struct proc {
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
   volatile int cpu_num;        // Process CPU number
+  uint64 runnable_cycles;      // Time CSR when p last became RUNNABLE
+  uint migrate_tick;           // When p last moved to another CPU, or 0
+  int affinity;                // Bit i set if p may run on CPU i
+};
+
+// Processes in one state (UNUSED, SLEEPING or ZOMBIE), linked
+// through next and prev, so that adding and taking off a process
+// are O(1) under the list's lock.
+struct proclist {
+  struct spinlock lock;
+  struct proc *head;
+  struct proc *tail;
+};
+
+// Processes sleeping on channels that hash to the same
+// bucket, see sleep() in proc.c.
+struct sleepq {
+  struct spinlock lock;
+  struct proc *head;
 };
@@ -0,0 +1,23 @@
+// Where fork() and wakeup() queue a process, see set_placement().
+#define PLACE_LOCAL        0   // The CPU it ran on last
+#define PLACE_LEAST_USED   1   // The CPU that admitted fewest processes
+#define PLACE_TWO_CHOICES  2   // The less loaded of two random CPUs
+
+// Scheduling latency histograms, copied out by getschedhist().
+// Bucket i counts intervals of [2^i, 2^(i+1)) time CSR cycles
+// (bucket 0 also holds 0); the time CSR runs at TIMEBASE_HZ.
+#define NHIST        32
+#define TIMEBASE_HZ  10000000   // qemu virt
+struct schedhist {
+  uint64 latency[NHIST];       // RUNNABLE until picked to run
+  uint64 slice[NHIST];         // Running until back in the scheduler
+  uint64 switches;             // Context switches into a process
+};
+
+// A CPU's cache of free proc slots, copied out by getproccache().
+struct proccache {
+  uint64 hits;                 // allocproc()s served from the cache
+  uint64 misses;               // ... that had to go to unused_list
+  uint64 spills;               // freeproc()s that found the cache full
+  int nfree;                   // Slots in the cache now
+};
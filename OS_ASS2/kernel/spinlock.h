@@ -1,6 +1,43 @@
+// Lock kinds, chosen per lock with initlock_kind().
+#define LOCK_TAS     0   // Test-and-set; every waiter spins on the lock word
+#define LOCK_TICKET  1   // FIFO tickets; waiters spin on the owner count
+#define LOCK_MCS     2   // FIFO queue; each waiter spins on its own node
+#define NLOCKKIND    3
+
+// Lock contention statistics, collected by kernels built with
+// LOCKSTAT=ON. Locks of one name, such as every process's lock,
+// share one entry; lockstat() copies the entries out.
+#define OFF 0
+#define ON 1
+#ifndef LOCKSTAT
+#define LOCKSTAT OFF
+#endif
+
+#define NLOCKCLASS  32
+struct lockstat {
+  char name[16];
+  uint64 acquires;     // Calls to acquire()
+  uint64 contended;    // Of those, ones that found the lock held
+  uint64 spin;         // Time CSR cycles spent waiting
+  uint64 max_hold;     // Longest hold, in time CSR cycles
+};
+
 // Mutual exclusion lock.
 struct spinlock {
   uint locked;       // Is the lock held?
+  uint kind;         // LOCK_TAS, LOCK_TICKET or LOCK_MCS
+
+  // LOCK_TICKET: next ticket to hand out, and the one now served.
+  uint next;
+  uint owner;
+
+  // LOCK_MCS: last waiter in the queue, and the holder's node.
+  struct mcsnode *tail;
+  struct mcsnode *node;
+
+  // LOCKSTAT: the entry of the lock's name, and when it was taken.
+  struct lockstat *stat;
+  uint64 acquired_at;
 
   // For debugging:
   char *name;        // Name of lock.
@@ -11,7 +11,7 @@ void timerinit();
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][7];
 
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
@@ -43,6 +43,11 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor mode read the time CSR, for the
+  // scheduling latency histograms, lockbench() and the
+  // LOCKSTAT lock statistics.
+  w_mcounteren(r_mcounteren() | 2);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -72,9 +77,13 @@ timerinit()
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
   // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[5] : set by timervec for each timer interrupt, see timer_fired().
+  // scratch[6] : address of CLINT MSIP register, for wakeup IPIs.
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
   scratch[4] = interval;
+  scratch[5] = 0;
+  scratch[6] = CLINT_MSIP(id);
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -83,6 +92,23 @@ timerinit()
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer interrupts, and software
+  // interrupts for wakeup IPIs from other harts.
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
+}
+
+// Did this hart's software interrupt come from the timer,
+// rather than only from a wakeup IPI? Clears the indication.
+// Interrupts must be disabled.
+int
+timer_fired(void)
+{
+  return __sync_lock_test_and_set(&timer_scratch[r_tp()][5], 0) != 0;
+}
+
+// Send a wakeup IPI to hart id, to get it out of wfi.
+void
+wakeup_hart(int id)
+{
+  *(volatile uint32*)CLINT_MSIP(id) = 1;
 }
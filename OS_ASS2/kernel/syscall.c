@@ -107,6 +107,14 @@ extern uint64 sys_uptime(void);
 extern uint64 sys_set_cpu(void);
 extern uint64 sys_get_cpu(void);
 extern uint64 sys_cpu_process_count(void);
+extern uint64 sys_getschedhist(void);
+extern uint64 sys_migration_count(void);
+extern uint64 sys_set_affinity(void);
+extern uint64 sys_get_affinity(void);
+extern uint64 sys_set_placement(void);
+extern uint64 sys_lockbench(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_getproccache(void);
 
 
 static uint64 (*syscalls[])(void) = {
@@ -134,6 +142,14 @@ static uint64 (*syscalls[])(void) = {
 [SYS_set_cpu] sys_set_cpu,
 [SYS_get_cpu] sys_get_cpu,
 [SYS_cpu_process_count] sys_cpu_process_count,
+[SYS_getschedhist] sys_getschedhist,
+[SYS_migration_count] sys_migration_count,
+[SYS_set_affinity] sys_set_affinity,
+[SYS_get_affinity] sys_get_affinity,
+[SYS_set_placement] sys_set_placement,
+[SYS_lockbench] sys_lockbench,
+[SYS_lockstat] sys_lockstat,
+[SYS_getproccache] sys_getproccache,
 
 };
 
@@ -23,3 +23,11 @@
 #define SYS_set_cpu 22
 #define SYS_get_cpu 23
 #define SYS_cpu_process_count 24
+#define SYS_getschedhist 25
+#define SYS_migration_count 26
+#define SYS_set_affinity 27
+#define SYS_get_affinity 28
+#define SYS_set_placement 29
+#define SYS_lockbench 30
+#define SYS_lockstat 31
+#define SYS_getproccache 32
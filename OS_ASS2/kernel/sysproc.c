@@ -121,3 +121,83 @@ sys_cpu_process_count(void)
   return cpu_process_count(cpu_num);
 }
 
+uint64
+sys_getschedhist(void)
+{
+  int cpu_num;
+  uint64 st;
+
+  if(argint(0, &cpu_num) < 0 || argaddr(1, &st) < 0)
+    return -1;
+  return getschedhist(cpu_num, st);
+}
+
+uint64
+sys_getproccache(void)
+{
+  int cpu_num;
+  uint64 st;
+
+  if(argint(0, &cpu_num) < 0 || argaddr(1, &st) < 0)
+    return -1;
+  return getproccache(cpu_num, st);
+}
+
+uint64
+sys_migration_count(void)
+{
+  int cpu_num;
+  if(argint(0, &cpu_num) < 0)
+    return -1;
+  return migration_count(cpu_num);
+}
+
+uint64
+sys_set_affinity(void)
+{
+  int pid, mask;
+  if(argint(0, &pid) < 0 || argint(1, &mask) < 0)
+    return -1;
+  return set_affinity(pid, mask);
+}
+
+uint64
+sys_get_affinity(void)
+{
+  int pid;
+  if(argint(0, &pid) < 0)
+    return -1;
+  return get_affinity(pid);
+}
+
+uint64
+sys_set_placement(void)
+{
+  int how;
+  if(argint(0, &how) < 0)
+    return -1;
+  return set_placement(how);
+}
+
+// Contend for the benchmark lock of one kind; see lockbench().
+uint64
+sys_lockbench(void)
+{
+  int kind, n;
+
+  if(argint(0, &kind) < 0 || argint(1, &n) < 0)
+    return -1;
+  return lockbench(kind, n);
+}
+
+// Copy out up to n lock statistics entries; see lockstat_copyout().
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return lockstat_copyout(addr, n);
+}
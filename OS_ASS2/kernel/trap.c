@@ -19,7 +19,7 @@ extern int devintr();
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  initlock_kind(&tickslock, "time", LOCK_TICKET);
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -172,6 +172,7 @@ clockintr()
 // and handle it.
 // returns 2 if timer interrupt,
 // 1 if other device,
+// 3 if wakeup IPI from another hart,
 // 0 if not recognized.
 int
 devintr()
@@ -202,16 +203,21 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000001L){
     // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // or from a wakeup IPI, forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
+    // a wakeup IPI only had to get this hart out of wfi;
+    // the scheduler loop will find the work it was sent for.
+    if(!timer_fired())
+      return 3;
+
+    if(cpuid() == 0){
+      clockintr();
+    }
+
     return 2;
   } else {
     return 0;
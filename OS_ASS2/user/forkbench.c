@@ -0,0 +1,110 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Per-CPU fork microbenchmark. Pins one worker to each CPU, and
+// each forks and reaps children as fast as it can for a while,
+// which takes and frees a proc slot and updates the per-CPU load
+// counters on every fork, exit and wakeup. Prints forks per 100
+// ticks of each worker and of all of them, next to how many of
+// those forks the CPU's free proc slot cache served; compare
+// kernels built with CPUS=3 and CPUS=8.
+//   forkbench [ticks]
+
+struct proccache before[NCPU], after[NCPU];
+
+// What a worker reports when its time is up. Sent with one write(),
+// so that records of workers finishing together cannot interleave.
+struct result {
+  int cpu;
+  int count;          // forks, or -1 if the worker could not run there
+};
+
+// Percentage of the allocations between b and a that hit.
+int
+hitrate(struct proccache *b, struct proccache *a)
+{
+  uint64 hits = a->hits - b->hits, allocs = hits + a->misses - b->misses;
+
+  return allocs ? (int)(hits * 100 / allocs) : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int duration = 100, fd[2], i, ncpu, total = 0;
+  int counts[NCPU];
+  struct result r;
+
+  if(argc > 1)
+    duration = atoi(argv[1]);
+  if(duration < 1 || pipe(fd) < 0){
+    fprintf(2, "usage: forkbench [ticks]\n");
+    exit(1);
+  }
+
+  for(ncpu = 0; ncpu < NCPU; ncpu++){
+    if(getproccache(ncpu, &before[ncpu]) < 0)
+      break;
+  }
+
+  for(i = 0; i < ncpu; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "forkbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      int end;
+
+      close(fd[0]);
+      r.cpu = i;
+      r.count = -1;
+      if(set_cpu(i) == i){
+        r.count = 0;
+        end = uptime() + duration;
+        while(uptime() < end){
+          if((pid = fork()) == 0)
+            exit(0);
+          if(pid < 0 || wait(0) != pid)
+            break;
+          r.count++;
+        }
+      }
+      write(fd[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fd[1]);
+
+  for(i = 0; i < ncpu; i++)
+    counts[i] = -1;
+  while(read(fd[0], &r, sizeof(r)) == sizeof(r)){
+    if(r.cpu >= 0 && r.cpu < ncpu)
+      counts[r.cpu] = r.count;
+  }
+  while(wait(0) > 0)
+    ;
+
+  for(i = 0; i < ncpu; i++){
+    getproccache(i, &after[i]);
+    if(counts[i] < 0){
+      fprintf(2, "forkbench: worker %d failed\n", i);
+      continue;
+    }
+    printf("cpu %d: %d forks/100 ticks, proc cache hits %d%%, %d spills\n",
+           i, counts[i] * 100 / duration, hitrate(&before[i], &after[i]),
+           (int)(after[i].spills - before[i].spills));
+    total += counts[i];
+  }
+  getproccache(-1, &after[0]);
+  for(i = 1; i < ncpu; i++){
+    before[0].hits += before[i].hits;
+    before[0].misses += before[i].misses;
+  }
+  printf("%d cpus: %d forks/100 ticks, proc cache hits %d%%\n", ncpu,
+         total * 100 / duration, hitrate(&before[0], &after[0]));
+  exit(0);
+}
@@ -0,0 +1,112 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Page allocator test through the real allocation paths. Several
+// children at once grow and shrink their memory and fork children
+// that write to it, so pages are taken and freed on every CPU and
+// move between the CPU caches and the buddy lists. Then checks that
+// every page came back: as many can be allocated as before.
+// Run it on an idle system.
+//   kalloctest [rounds]
+
+#define NCHILD  4
+#define MAXGROW 64    // most pages a child grows by at once
+
+// Count the free pages: a child takes pages with sbrk() until it
+// fails, sends a byte for each, and exits, freeing them all again.
+int
+countfree(void)
+{
+  int fd[2], n = 0;
+  char c, *a;
+
+  if(pipe(fd) < 0){
+    fprintf(2, "kalloctest: pipe failed\n");
+    exit(1);
+  }
+  if(fork() == 0){
+    close(fd[0]);
+    while((a = sbrk(4096)) != (char*)-1){
+      a[4095] = 1;   // touch it, in case sbrk() is ever lazy
+      if(write(fd[1], "x", 1) != 1)
+        break;
+    }
+    exit(0);
+  }
+  close(fd[1]);
+  while(read(fd[0], &c, 1) == 1)
+    n++;
+  close(fd[0]);
+  wait(0);
+  return n;
+}
+
+void
+churn(int seed, int rounds)
+{
+  char *a;
+  int i, n, pid;
+
+  for(i = 0; i < rounds; i++){
+    seed = seed * 1103515245 + 12345;
+    n = 1 + ((seed >> 16) & 0x7fff) % MAXGROW;
+    if((a = sbrk(n * 4096)) == (char*)-1){
+      fprintf(2, "kalloctest: sbrk failed\n");
+      exit(1);
+    }
+    memset(a, i, n * 4096);
+    if((pid = fork()) < 0){
+      fprintf(2, "kalloctest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      // write half of it, copying pages that fork shares.
+      memset(a, 0xff, n * 2048);
+      exit(0);
+    }
+    wait(0);
+    if(sbrk(-n * 4096) == (char*)-1){
+      fprintf(2, "kalloctest: sbrk failed\n");
+      exit(1);
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 100, before, after, i, status, ok = 1;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+
+  // the first count warms up the caches countfree() itself uses.
+  countfree();
+  before = countfree();
+
+  for(i = 0; i < NCHILD; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "kalloctest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      churn(i + 1, rounds);
+      exit(0);
+    }
+  }
+  for(i = 0; i < NCHILD; i++){
+    if(wait(&status) < 0 || status != 0)
+      ok = 0;
+  }
+
+  after = countfree();
+  printf("kalloctest: %d free pages before, %d after\n", before, after);
+  if(!ok || after < before){
+    fprintf(2, "kalloctest: FAILED%s\n", ok ? ", lost free pages" : "");
+    exit(1);
+  }
+  printf("kalloctest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,120 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Process state list stress test. Several workers at once
+// keep forking children that sleep, block on a pipe and get
+// killed, or exit right away, and reap them; so processes move
+// between the UNUSED, RUNNABLE, SLEEPING and ZOMBIE lists from
+// all CPUs. Each child must be reaped exactly once, and as many
+// processes must fit in the table afterwards as before.
+//   listtest [workers [iterations]]
+
+// Fork blocked children until the table is full, then let them
+// all go. Returns how many fitted.
+int
+capacity(void)
+{
+  int fd[2], n = 0, pid;
+  char c;
+
+  if(pipe(fd) < 0){
+    fprintf(2, "listtest: pipe failed\n");
+    exit(1);
+  }
+  while((pid = fork()) >= 0){
+    if(pid == 0){
+      close(fd[1]);
+      read(fd[0], &c, 1);
+      exit(0);
+    }
+    n++;
+  }
+  close(fd[0]);
+  close(fd[1]);
+  while(wait(0) > 0)
+    ;
+  return n;
+}
+
+int
+worker(int iterations)
+{
+  int fd[2], pid, status, i;
+  char c;
+
+  for(i = 0; i < iterations; i++){
+    if(pipe(fd) < 0)
+      return -1;
+    if((pid = fork()) < 0){
+      fprintf(2, "listtest: fork failed\n");
+      return -1;
+    }
+    if(pid == 0){
+      close(fd[1]);
+      if(i % 3 == 1)
+        sleep(1);
+      else if(i % 3 == 2)
+        read(fd[0], &c, 1);  // until killed
+      exit(i % 100);
+    }
+    close(fd[0]);
+    if(i % 3 == 2){
+      sleep(1);
+      kill(pid);
+    }
+    if(wait(&status) != pid){
+      fprintf(2, "listtest: lost child %d\n", pid);
+      return -1;
+    }
+    if(i % 3 != 2 && status != i % 100){
+      fprintf(2, "listtest: child %d exited with %d\n", pid, status);
+      return -1;
+    }
+    close(fd[1]);
+  }
+  if(wait(0) >= 0){
+    fprintf(2, "listtest: child reaped twice\n");
+    return -1;
+  }
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int workers = 4, iterations = 60;
+  int before, after, status, i, failed = 0;
+
+  if(argc > 1)
+    workers = atoi(argv[1]);
+  if(argc > 2)
+    iterations = atoi(argv[2]);
+
+  before = capacity();
+  for(i = 0; i < workers; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "listtest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      exit(worker(iterations) < 0);
+  }
+  for(i = 0; i < workers; i++){
+    if(wait(&status) < 0 || status != 0)
+      failed = 1;
+  }
+  after = capacity();
+
+  if(failed){
+    printf("listtest: FAILED\n");
+    exit(1);
+  }
+  if(after != before){
+    printf("listtest: FAILED, room for %d processes before, %d after\n", before, after);
+    exit(1);
+  }
+  printf("listtest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,81 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Placement benchmark. Runs the same mix of children, which
+// compute for a while and then sleep, over and over, under each
+// placement policy, and prints how long all of them took and how
+// many compute bursts each CPU ran. Build with BLNCFLG=OFF to
+// see placement on its own, without stealing and balancing.
+//   placebench [children [bursts]]
+
+char *names[] = {
+[PLACE_LOCAL]        "local",
+[PLACE_LEAST_USED]   "least_used",
+[PLACE_TWO_CHOICES]  "two_choices",
+};
+
+void
+run(int how, int n, int bursts)
+{
+  int fd[2], bursts_on[NCPU], cpu, i, start, old;
+
+  memset(bursts_on, 0, sizeof(bursts_on));
+  if(pipe(fd) < 0){
+    fprintf(2, "placebench: pipe failed\n");
+    exit(1);
+  }
+  old = set_placement(how);
+  start = uptime();
+  for(i = 0; i < n; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "placebench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(fd[0]);
+      for(int b = 0; b < bursts; b++){
+        // alternate long and short bursts between children.
+        volatile int count = 0;
+        int work = (i % 2) ? 4000000 : 1000000;
+        while(count < work)
+          count++;
+        cpu = get_cpu();
+        write(fd[1], &cpu, sizeof(cpu));
+        sleep(1);
+      }
+      exit(0);
+    }
+  }
+  close(fd[1]);
+  while(read(fd[0], &cpu, sizeof(cpu)) == sizeof(cpu)){
+    if(cpu >= 0 && cpu < NCPU)
+      bursts_on[cpu]++;
+  }
+  close(fd[0]);
+  while(wait(0) > 0)
+    ;
+  printf("%s:\t%d ticks, bursts per cpu:", names[how], uptime() - start);
+  for(i = 0; i < NCPU; i++)
+    if(bursts_on[i])
+      printf(" %d", bursts_on[i]);
+  printf("\n");
+  set_placement(old);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = 12, bursts = 20;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(argc > 2)
+    bursts = atoi(argv[2]);
+  for(int how = PLACE_LOCAL; how <= PLACE_TWO_CHOICES; how++)
+    run(how, n, bursts);
+  exit(0);
+}
@@ -0,0 +1,56 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Print scheduling latency and slice percentiles of each CPU
+// and of all of them together, from getschedhist().
+
+// Upper bound, in microseconds, of the bucket that holds
+// the pct-th percentile of histogram h.
+int
+percentile(uint64 *h, int pct)
+{
+  uint64 total = 0, seen = 0;
+  int b;
+
+  for(b = 0; b < NHIST; b++)
+    total += h[b];
+  for(b = 0; b < NHIST; b++){
+    seen += h[b];
+    if(seen * 100 >= total * pct)
+      break;
+  }
+  return (int)((2UL << b) / (TIMEBASE_HZ / 1000000));
+}
+
+void
+show(char *name, struct schedhist *h)
+{
+  printf("%s\t%d\t\t%d\t%d\t%d\t\t%d\n", name, (int)h->switches,
+         percentile(h->latency, 50), percentile(h->latency, 99),
+         percentile(h->slice, 50), percentile(h->slice, 99));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct schedhist h;
+  char name[8];
+  int i;
+
+  printf("cpu\tswitches\tlat p50\tlat p99\tslice p50\tslice p99 (us, upper bound)\n");
+  for(i = 0; getschedhist(i, &h) == 0; i++){
+    if(h.switches == 0)
+      continue;
+    name[0] = '0' + i;
+    name[1] = 0;
+    show(name, &h);
+  }
+  if(getschedhist(-1, &h) < 0){
+    fprintf(2, "schedlat: getschedhist failed\n");
+    exit(1);
+  }
+  show("all", &h);
+  exit(0);
+}
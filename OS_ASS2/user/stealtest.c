@@ -0,0 +1,131 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Work stealing and load balancing stress test. Piles CPU-bound
+// children onto CPU 0, free to run anywhere, and checks that every
+// one of them runs to completion exactly once, wherever it was moved
+// to. Built with BLNCFLG=ON, it also fails if no child was moved off
+// CPU 0 although there are other CPUs.
+//   stealtest [children [rounds]]
+
+// BLNCFLG comes from the Makefile as ON or OFF, as in kernel/proc.h.
+#define OFF 0
+#define ON 1
+#ifndef BLNCFLG
+#define BLNCFLG OFF
+#endif
+
+#define MAXCHILD 32
+
+// What a child reports when it finishes. Sent with one write(), so
+// that records of children finishing together cannot interleave.
+struct result {
+  int who;
+  int cpu;
+};
+
+int
+run_round(int n)
+{
+  int seen[MAXCHILD], exited[MAXCHILD], ran_on[NCPU];
+  int fd[2], i, status, pid, moved = 0;
+  struct result r;
+
+  memset(seen, 0, sizeof(seen));
+  memset(exited, 0, sizeof(exited));
+  memset(ran_on, 0, sizeof(ran_on));
+  if(pipe(fd) < 0){
+    fprintf(2, "stealtest: pipe failed\n");
+    return -1;
+  }
+
+  for(i = 0; i < n; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "stealtest: fork failed\n");
+      return -1;
+    }
+    if(pid == 0){
+      volatile uint64 count = 0;
+
+      close(fd[0]);
+      // start on CPU 0, but let stealing and balancing move us:
+      // set_cpu() also pins, so widen the mask back out.
+      set_cpu(0);
+      set_affinity(0, -1);
+      while(count < 20000000)
+        count++;
+      r.who = i;
+      r.cpu = get_cpu();
+      write(fd[1], &r, sizeof(r));
+      exit(i);
+    }
+  }
+  close(fd[1]);
+
+  for(i = 0; i < n; i++){
+    if(read(fd[0], &r, sizeof(r)) != sizeof(r)){
+      fprintf(2, "stealtest: only %d of %d children finished\n", i, n);
+      return -1;
+    }
+    if(r.who < 0 || r.who >= n || seen[r.who]++){
+      fprintf(2, "stealtest: child %d finished twice\n", r.who);
+      return -1;
+    }
+    if(r.cpu >= 0 && r.cpu < NCPU)
+      ran_on[r.cpu]++;
+    if(r.cpu != 0)
+      moved++;
+  }
+  close(fd[0]);
+
+  for(i = 0; i < n; i++){
+    if(wait(&status) < 0 || status < 0 || status >= n || exited[status]++){
+      fprintf(2, "stealtest: bad exit of child %d\n", status);
+      return -1;
+    }
+  }
+  if(wait(0) >= 0){
+    fprintf(2, "stealtest: extra child\n");
+    return -1;
+  }
+
+  printf("%d children, %d stolen, finished on:", n, moved);
+  for(i = 0; i < NCPU; i++)
+    if(ran_on[i])
+      printf(" cpu%d=%d", i, ran_on[i]);
+  printf("\n");
+  return moved;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = 16, rounds = 5, moved, total = 0, ncpu;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(n < 1 || n > MAXCHILD){
+    fprintf(2, "stealtest: at most %d children\n", MAXCHILD);
+    exit(1);
+  }
+
+  for(int r = 0; r < rounds; r++){
+    if((moved = run_round(n)) < 0)
+      exit(1);
+    total += moved;
+  }
+  printf("moved onto:");
+  for(ncpu = 0; ncpu < NCPU && migration_count(ncpu) >= 0; ncpu++)
+    printf(" cpu%d=%d", ncpu, migration_count(ncpu));
+  printf("\n");
+  if(BLNCFLG && ncpu > 1 && total == 0){
+    fprintf(2, "stealtest: no child left CPU 0 in %d rounds\n", rounds);
+    exit(1);
+  }
+  printf("stealtest: OK\n");
+  exit(0);
+}
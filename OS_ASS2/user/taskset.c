@@ -0,0 +1,44 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Show or set the CPU affinity of processes, as a bitmask
+// with bit i for CPU i.
+//   taskset mask prog [args...]   run prog on the CPUs in mask
+//   taskset -p pid                print the mask of pid
+//   taskset -p pid mask           set the mask of pid
+
+int
+main(int argc, char *argv[])
+{
+  int pid, mask;
+
+  if(argc >= 3 && strcmp(argv[1], "-p") == 0){
+    pid = atoi(argv[2]);
+    if(argc == 3){
+      if((mask = get_affinity(pid)) < 0){
+        fprintf(2, "taskset: no process %d\n", pid);
+        exit(1);
+      }
+      printf("%d: mask %x\n", pid, mask);
+      exit(0);
+    }
+    if(set_affinity(pid, atoi(argv[3])) < 0){
+      fprintf(2, "taskset: cannot set the mask of %d\n", pid);
+      exit(1);
+    }
+    exit(0);
+  }
+
+  if(argc < 3){
+    fprintf(2, "usage: taskset mask prog [args...] | taskset -p pid [mask]\n");
+    exit(1);
+  }
+  if(set_affinity(0, atoi(argv[1])) < 0){
+    fprintf(2, "taskset: bad mask %s\n", argv[1]);
+    exit(1);
+  }
+  exec(argv[2], argv + 2);
+  fprintf(2, "taskset: exec %s failed\n", argv[2]);
+  exit(1);
+}
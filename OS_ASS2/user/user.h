@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct lockstat;
+struct schedhist;
+struct proccache;
 
 // system calls
 int fork(void);
@@ -26,6 +29,14 @@ int uptime(void);
 int set_cpu(int);
 int get_cpu();
 int cpu_process_count(int);
+int getschedhist(int, struct schedhist*);
+int getproccache(int, struct proccache*);
+int migration_count(int);
+int set_affinity(int, int);
+int get_affinity(int);
+int set_placement(int);
+int lockbench(int, int);
+int lockstat(struct lockstat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -39,3 +39,11 @@ entry("uptime");
 entry("set_cpu");
 entry("get_cpu");
 entry("cpu_process_count");
+entry("getschedhist");
+entry("migration_count");
+entry("set_affinity");
+entry("get_affinity");
+entry("set_placement");
+entry("lockbench");
+entry("lockstat");
+entry("getproccache");
@@ -1,6 +1,7 @@
 struct buf;
 struct context;
 struct file;
+struct kmem_cache;
 struct inode;
 struct pipe;
 struct proc;
@@ -25,6 +26,12 @@ void            consputc(int);
 // exec.c
 int             exec(char*, char**);
 
+// slab.c
+struct kmem_cache* kmem_cache_create(char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+void            kmem_cache_dump(void);
+
 // file.c
 struct file*    filealloc(void);
 void            fileclose(struct file*);
@@ -63,6 +70,10 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kalloc_order(int);
+void            kfree_order(void *, int);
+void            kalloc_test(void);
+void            kmemdump(void);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -72,6 +83,7 @@ void            end_op(void);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
+void            pipeinit(void);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
@@ -112,6 +124,10 @@ void            swtch(struct context*, struct context*);
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initlock_kind(struct spinlock*, char*, int);
+uint64          lockbench(int, int);
+int             lockstat_copyout(uint64, int);
+void            lockdump(void);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
@@ -11,6 +11,14 @@ struct cpu cpus[NCPU];
 
 struct proc proc[NPROC];
 
+// Sleep queues: sleeping processes hashed by chan, so that
+// wakeup() only looks at processes whose channels share a
+// bucket with chan. A process puts itself on its queue in
+// sleep() and takes itself off again when it wakes up, so
+// wakeup() and kill() only have to make it RUNNABLE.
+// Lock order: a queue's lock, then p->lock.
+struct sleepq sleepqs[NSLEEPQ];
+
 struct proc *initproc;
 
 int nextpid = 1;
@@ -51,6 +59,8 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  for(int i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepqs[i].lock, "sleepq");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->kstack = KSTACK((int) (p - proc));
@@ -268,6 +278,33 @@ growproc(int n)
   return 0;
 }
 
+// Put child c on the list *l of its parent's children or zombies.
+// Caller must hold wait_lock.
+static void
+child_link(struct proc **l, struct proc *c)
+{
+  c->sibling_prev = 0;
+  c->sibling_next = *l;
+  if(*l)
+    (*l)->sibling_prev = c;
+  *l = c;
+}
+
+// Take child c off the list *l it is on.
+// Caller must hold wait_lock.
+static void
+child_unlink(struct proc **l, struct proc *c)
+{
+  if(c->sibling_prev)
+    c->sibling_prev->sibling_next = c->sibling_next;
+  else
+    *l = c->sibling_next;
+  if(c->sibling_next)
+    c->sibling_next->sibling_prev = c->sibling_prev;
+  c->sibling_next = 0;
+  c->sibling_prev = 0;
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 int
@@ -310,6 +347,7 @@ fork(void)
 
   acquire(&wait_lock);
   np->parent = p;
+  child_link(&p->children, np);
   release(&wait_lock);
 
   acquire(&np->lock);
@@ -326,11 +364,18 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
+  while((pp = p->children) != 0){
+    child_unlink(&p->children, pp);
+    pp->parent = initproc;
+    child_link(&initproc->children, pp);
+  }
+  if(p->zombies){
+    while((pp = p->zombies) != 0){
+      child_unlink(&p->zombies, pp);
       pp->parent = initproc;
-      wakeup(initproc);
+      child_link(&initproc->zombies, pp);
     }
+    wakeup(initproc);
   }
 }
 
@@ -372,6 +417,10 @@ exit(int status)
   p->xstate = status;
   p->state = ZOMBIE;
 
+  // Ready for the parent's wait() to reap.
+  child_unlink(&p->parent->children, p);
+  child_link(&p->parent->zombies, p);
+
   release(&wait_lock);
 
   // Jump into the scheduler, never to return.
@@ -385,40 +434,33 @@ int
 wait(uint64 addr)
 {
   struct proc *np;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
-          release(&np->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    // Any exited child will do.
+    np = p->zombies;
+    if(np){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      pid = np->pid;
+      if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                              sizeof(np->xstate)) < 0) {
         release(&np->lock);
+        release(&wait_lock);
+        return -1;
       }
+      child_unlink(&p->zombies, np);
+      freeproc(np);
+      release(&np->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || p->killed){
+    if(p->children == 0 || p->killed){
       release(&wait_lock);
       return -1;
     }
@@ -524,34 +566,59 @@ forkret(void)
   usertrapret();
 }
 
+// The sleep queue of chan, see sleepqs.
+static struct sleepq*
+sleepq_of(void *chan)
+{
+  return &sleepqs[((uint64)chan >> 3) % NSLEEPQ];
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *q = sleepq_of(chan);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
-  // so it's okay to release lk.
+  // Once we are on chan's sleep queue and hold
+  // p->lock, we can be guaranteed that we won't
+  // miss any wakeup (wakeup locks the queue and
+  // then p->lock), so it's okay to release lk.
 
+  acquire(&q->lock);
   acquire(&p->lock);  //DOC: sleeplock1
-  release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->sq_prev = 0;
+  p->sq_next = q->head;
+  if(q->head)
+    q->head->sq_prev = p;
+  q->head = p;
+  release(&q->lock);
+  release(lk);
 
   sched();
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  // Until we are off the queue, wakeup() skips us for our chan.
+  acquire(&q->lock);
+  if(p->sq_prev)
+    p->sq_prev->sq_next = p->sq_next;
+  else
+    q->head = p->sq_next;
+  if(p->sq_next)
+    p->sq_next->sq_prev = p->sq_prev;
+  release(&q->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
@@ -560,17 +627,22 @@ sleep(void *chan, struct spinlock *lk)
 void
 wakeup(void *chan)
 {
+  struct sleepq *q = sleepq_of(chan);
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
+  acquire(&q->lock);
+  for(p = q->head; p; p = p->sq_next){
+    // Only a process that is no longer asleep changes its chan
+    // without q->lock, so others' channels can be skipped unlocked.
+    if(p->chan != chan)
+      continue;
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan) {
+      p->state = RUNNABLE;
     }
+    release(&p->lock);
   }
+  release(&q->lock);
 }
 
 // Kill the process with the given pid.
@@ -654,4 +726,7 @@ procdump(void)
     printf("%d %s %s", p->pid, state, p->name);
     printf("\n");
   }
+  kmemdump();
+  kmem_cache_dump();
+  lockdump();
 }
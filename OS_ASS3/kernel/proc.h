@@ -93,8 +93,16 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
+  // the lock of chan's sleep queue must be held when using these:
+  struct proc *sq_next;        // Other processes on the same sleep queue
+  struct proc *sq_prev;
+
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
+  struct proc *children;       // Children that have not exited
+  struct proc *zombies;        // Children that have exited, not yet waited for
+  struct proc *sibling_next;   // Next and previous on parent's children
+  struct proc *sibling_prev;   // or zombies list
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
@@ -106,3 +114,10 @@ struct proc {
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
 };
+
+// Processes sleeping on channels that hash to the same
+// bucket, see sleep() in proc.c.
+struct sleepq {
+  struct spinlock lock;
+  struct proc *head;
+};
@@ -0,0 +1,208 @@
+// Object caches for small fixed-size kernel objects, such as
+// pipes and open files. Each cache carves whole pages (slabs)
+// into objects of one size, and grows by a page whenever it
+// runs out, so it has no fixed limit.
+//
+// Each CPU keeps a magazine, a small stack of free objects, in
+// every cache. kmem_cache_alloc() and kmem_cache_free() work on
+// the running CPU's magazine with interrupts off and take the
+// cache's lock only to refill or flush half of it.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NKMEMCACHE 8    // caches in the system
+#define MAGSIZE    16   // objects in a full magazine
+
+// Header at the start of each slab page; the objects follow it.
+struct slab {
+  struct slab *next;     // On the cache's partial list
+  struct slab *prev;
+  void *free;            // Free objects, linked through their first word
+  int inuse;             // Objects handed out, magazines included
+};
+
+struct magazine {
+  int n;
+  void *objs[MAGSIZE];
+} __attribute__((aligned(CACHELINE)));
+
+struct kmem_cache {
+  char name[16];
+  uint size;             // Object size, a multiple of 8
+  int perslab;           // Objects in one slab
+  struct spinlock lock;  // Protects the slabs and counts below
+  struct slab *partial;  // Slabs with a free object
+  int nslabs;
+  int inuse;
+  struct magazine mags[NCPU];
+};
+
+static struct kmem_cache caches[NKMEMCACHE];
+static int ncaches;
+
+// Create a cache of objects of the given size.
+// Called during boot, before there is more than one CPU.
+struct kmem_cache*
+kmem_cache_create(char *name, uint size)
+{
+  struct kmem_cache *c;
+  uint hdr = (sizeof(struct slab) + 7) & ~7;
+
+  size = (size + 7) & ~7;
+  if(ncaches == NKMEMCACHE || size < sizeof(void*) || size > PGSIZE - hdr)
+    panic("kmem_cache_create");
+  c = &caches[ncaches++];
+  safestrcpy(c->name, name, sizeof(c->name));
+  c->size = size;
+  c->perslab = (PGSIZE - hdr) / size;
+  initlock(&c->lock, c->name);
+  return c;
+}
+
+// Add a fresh slab to c's partial list.
+// Returns 0 if there is no memory for it.
+static struct slab*
+slab_grow(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *obj;
+  int i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->inuse = 0;
+  s->free = 0;
+  obj = (char*)s + PGSIZE - c->perslab * c->size;
+  for(i = 0; i < c->perslab; i++, obj += c->size){
+    *(void**)obj = s->free;
+    s->free = obj;
+  }
+  s->prev = 0;
+  s->next = c->partial;
+  if(c->partial)
+    c->partial->prev = s;
+  c->partial = s;
+  c->nslabs++;
+  return s;
+}
+
+static void
+slab_unlink(struct kmem_cache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Fill m halfway from c's slabs. Caller must have interrupts off.
+static void
+magazine_fill(struct kmem_cache *c, struct magazine *m)
+{
+  struct slab *s;
+  void *obj;
+
+  acquire(&c->lock);
+  while(m->n < MAGSIZE / 2){
+    if((s = c->partial) == 0 && (s = slab_grow(c)) == 0)
+      break;
+    obj = s->free;
+    s->free = *(void**)obj;
+    if(++s->inuse == c->perslab)
+      slab_unlink(c, s);
+    c->inuse++;
+    m->objs[m->n++] = obj;
+  }
+  release(&c->lock);
+}
+
+// Give the older half of m back to c's slabs, and the pages of
+// slabs that become empty back to kalloc().
+// Caller must have interrupts off.
+static void
+magazine_flush(struct kmem_cache *c, struct magazine *m)
+{
+  struct slab *s;
+  void *obj;
+  int i;
+
+  acquire(&c->lock);
+  for(i = 0; i < MAGSIZE / 2; i++){
+    obj = m->objs[i];
+    s = (struct slab*)PGROUNDDOWN((uint64)obj);
+    if(s->inuse-- == c->perslab){
+      s->prev = 0;
+      s->next = c->partial;
+      if(c->partial)
+        c->partial->prev = s;
+      c->partial = s;
+    }
+    *(void**)obj = s->free;
+    s->free = obj;
+    c->inuse--;
+    if(s->inuse == 0){
+      slab_unlink(c, s);
+      c->nslabs--;
+      kfree((char*)s);
+    }
+  }
+  release(&c->lock);
+  memmove(m->objs, m->objs + MAGSIZE / 2, (m->n - MAGSIZE / 2) * sizeof(void*));
+  m->n -= MAGSIZE / 2;
+}
+
+// Allocate a zeroed object from c.
+// Returns 0 if the memory cannot be allocated.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  void *obj = 0;
+
+  push_off();
+  m = &c->mags[cpuid()];
+  if(m->n == 0)
+    magazine_fill(c, m);
+  if(m->n > 0)
+    obj = m->objs[--m->n];
+  pop_off();
+
+  if(obj)
+    memset(obj, 0, c->size);
+  return obj;
+}
+
+// Return an object that kmem_cache_alloc(c) handed out.
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct magazine *m;
+
+  push_off();
+  m = &c->mags[cpuid()];
+  if(m->n == MAGSIZE)
+    magazine_flush(c, m);
+  m->objs[m->n++] = obj;
+  pop_off();
+}
+
+// Print every cache's use, for procdump().
+// No locks, like procdump().
+void
+kmem_cache_dump(void)
+{
+  struct kmem_cache *c;
+
+  for(c = caches; c < &caches[ncaches]; c++){
+    printf("cache %s: %d-byte objects, %d slabs, %d in use\n",
+           c->name, c->size, c->nslabs, c->inuse);
+  }
+}
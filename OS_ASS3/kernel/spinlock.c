@@ -8,12 +8,166 @@
 #include "proc.h"
 #include "defs.h"
 
+// MCS locks a cpu can hold or wait for at the same time.
+#define NMCSNODE 8
+
+// An MCS waiter. Each cpu has its own nodes, each on its own
+// cache line, so a waiter spins on a line no other cpu reads
+// until its predecessor hands the lock over.
+struct mcsnode {
+  struct mcsnode * volatile next;  // Next waiter, once it links itself
+  volatile uint locked;            // Set by the predecessor on hand-over
+  uint busy;                       // In use by this cpu
+} __attribute__((aligned(CACHELINE)));
+
+static struct mcsnode mcsnodes[NCPU][NMCSNODE];
+
+// LOCKSTAT entries. lockstats_lock is not initialized with
+// initlock(), so it is not counted itself.
+static struct lockstat lockstats[NLOCKCLASS];
+static int nlockstats;
+static struct spinlock lockstats_lock = { .name = "lockstats" };
+
+// Find or add the entry for locks called name.
+// Returns 0 if the table is full; such locks go uncounted.
+static struct lockstat*
+lockstat_of(char *name)
+{
+  struct lockstat *s;
+
+  acquire(&lockstats_lock);
+  for(s = lockstats; s < &lockstats[nlockstats]; s++){
+    if(strncmp(s->name, name, sizeof(s->name) - 1) == 0)
+      break;
+  }
+  if(s == &lockstats[nlockstats]){
+    if(nlockstats < NLOCKCLASS){
+      safestrcpy(s->name, name, sizeof(s->name));
+      nlockstats++;
+    } else {
+      s = 0;
+    }
+  }
+  release(&lockstats_lock);
+  return s;
+}
+
 void
 initlock(struct spinlock *lk, char *name)
+{
+  initlock_kind(lk, name, LOCK_TAS);
+}
+
+void
+initlock_kind(struct spinlock *lk, char *name, int kind)
 {
   lk->name = name;
+  lk->kind = kind;
   lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
+  lk->tail = 0;
+  lk->node = 0;
   lk->cpu = 0;
+  lk->stat = LOCKSTAT ? lockstat_of(name) : 0;
+}
+
+// Take the next ticket and wait for it to be served.
+// Returns whether the lock was held by another cpu.
+static int
+ticket_acquire(struct spinlock *lk)
+{
+  uint t = __sync_fetch_and_add(&lk->next, 1);
+
+  if(*(volatile uint *)&lk->owner == t)
+    return 0;
+  while(*(volatile uint *)&lk->owner != t)
+    ;
+  return 1;
+}
+
+// Interrupts must be off, so that nothing else on this cpu
+// can take a node between the check and the claim.
+static struct mcsnode*
+mcs_node(void)
+{
+  struct mcsnode *n;
+
+  for(n = mcsnodes[cpuid()]; n < &mcsnodes[cpuid()][NMCSNODE]; n++){
+    if(!n->busy){
+      n->busy = 1;
+      return n;
+    }
+  }
+  panic("mcs_node");
+}
+
+// Queue behind the last waiter, if any, and spin on our own
+// node until it hands the lock over.
+// Returns whether the lock was held by another cpu.
+static int
+mcs_acquire(struct spinlock *lk)
+{
+  struct mcsnode *n = mcs_node(), *pred;
+
+  n->next = 0;
+  n->locked = 0;
+  // the node must be reset before another cpu can see it.
+  __sync_synchronize();
+  pred = __sync_lock_test_and_set(&lk->tail, n);
+  if(pred){
+    pred->next = n;
+    while(!n->locked)
+      ;
+  }
+  lk->node = n;
+  return pred != 0;
+}
+
+// Count an acquisition of lk, which found the lock held if spun,
+// and start timing the hold.
+static void
+lockstat_acquired(struct spinlock *lk, int spun, uint64 start)
+{
+  struct lockstat *s = lk->stat;
+
+  lk->acquired_at = r_time();
+  __sync_fetch_and_add(&s->acquires, 1);
+  if(spun){
+    __sync_fetch_and_add(&s->contended, 1);
+    __sync_fetch_and_add(&s->spin, lk->acquired_at - start);
+  }
+}
+
+// Other locks of the same name may be released at the same time.
+static void
+lockstat_released(struct spinlock *lk)
+{
+  struct lockstat *s = lk->stat;
+  uint64 hold = r_time() - lk->acquired_at, max;
+
+  while((max = s->max_hold) < hold &&
+        !__sync_bool_compare_and_swap(&s->max_hold, max, hold))
+    ;
+}
+
+static void
+mcs_release(struct spinlock *lk)
+{
+  struct mcsnode *n = lk->node;
+
+  if(n->next == 0){
+    // no waiter we know of; empty the queue unless one just
+    // swapped itself in, then wait for it to link behind us.
+    if(__sync_bool_compare_and_swap(&lk->tail, n, 0)){
+      n->busy = 0;
+      return;
+    }
+    while(n->next == 0)
+      ;
+  }
+  n->next->locked = 1;
+  n->busy = 0;
 }
 
 // Acquire the lock.
@@ -21,6 +175,9 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint64 start = 0;
+  int spun = 0;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
@@ -29,8 +186,19 @@ acquire(struct spinlock *lk)
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  if(LOCKSTAT && lk->stat)
+    start = r_time();
+  switch(lk->kind){
+  case LOCK_TICKET:
+    spun = ticket_acquire(lk);
+    break;
+  case LOCK_MCS:
+    spun = mcs_acquire(lk);
+    break;
+  default:
+    while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+      spun = 1;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -39,7 +207,12 @@ acquire(struct spinlock *lk)
   __sync_synchronize();
 
   // Record info about lock acquisition for holding() and debugging.
+  // Queued kinds keep locked only for holding(); the holder alone writes it.
+  if(lk->kind != LOCK_TAS)
+    lk->locked = 1;
   lk->cpu = mycpu();
+  if(LOCKSTAT && lk->stat)
+    lockstat_acquired(lk, spun, start);
 }
 
 // Release the lock.
@@ -49,7 +222,11 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  if(LOCKSTAT && lk->stat)
+    lockstat_released(lk);
   lk->cpu = 0;
+  if(lk->kind != LOCK_TAS)
+    lk->locked = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
   // past this point, to ensure that all the stores in the critical
@@ -66,7 +243,17 @@ release(struct spinlock *lk)
   // On RISC-V, sync_lock_release turns into an atomic swap:
   //   s1 = &lk->locked
   //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  // Queued kinds hand the lock to the next waiter instead.
+  switch(lk->kind){
+  case LOCK_TICKET:
+    __sync_fetch_and_add(&lk->owner, 1);
+    break;
+  case LOCK_MCS:
+    mcs_release(lk);
+    break;
+  default:
+    __sync_lock_release(&lk->locked);
+  }
 
   pop_off();
 }
@@ -81,6 +268,72 @@ holding(struct spinlock *lk)
   return r;
 }
 
+// Locks for lockbench(), one of each kind, and the data they guard.
+static struct spinlock benchlocks[NLOCKKIND] = {
+[LOCK_TAS]    { .kind = LOCK_TAS,    .name = "bench_tas" },
+[LOCK_TICKET] { .kind = LOCK_TICKET, .name = "bench_ticket" },
+[LOCK_MCS]    { .kind = LOCK_MCS,    .name = "bench_mcs" },
+};
+static uint64 benchcount[NLOCKKIND];
+
+// Take and drop the benchmark lock of the given kind n times.
+// Returns the longest wait for it, in time CSR cycles.
+uint64
+lockbench(int kind, int n)
+{
+  uint64 start, wait, worst = 0;
+  struct spinlock *lk;
+
+  if(kind < 0 || kind >= NLOCKKIND || n < 0)
+    return -1;
+  lk = &benchlocks[kind];
+  for(int i = 0; i < n; i++){
+    start = r_time();
+    acquire(lk);
+    wait = r_time() - start;
+    benchcount[kind]++;
+    release(lk);
+    if(wait > worst)
+      worst = wait;
+  }
+  return worst;
+}
+
+// Copy out up to n LOCKSTAT entries to the user array at addr.
+// Returns the number copied, or -1 if statistics are not kept.
+int
+lockstat_copyout(uint64 addr, int n)
+{
+  int i;
+
+  if(!LOCKSTAT || n < 0)
+    return -1;
+  for(i = 0; i < n && i < nlockstats; i++){
+    if(copyout(myproc()->pagetable, addr + i * sizeof(struct lockstat),
+               (char *)&lockstats[i], sizeof(struct lockstat)) < 0)
+      return -1;
+  }
+  return i;
+}
+
+// Print the LOCKSTAT entries to the console, for procdump().
+// The time CSR runs at 10MHz on qemu virt, so cycles / 10 is us.
+void
+lockdump(void)
+{
+  struct lockstat *s;
+
+  if(!LOCKSTAT)
+    return;
+  printf("lock\tacquires\tcontended\tspin us\thold us\n");
+  for(s = lockstats; s < &lockstats[nlockstats]; s++){
+    if(s->acquires == 0)
+      continue;
+    printf("%s\t%d\t%d\t%d\t%d\n", s->name, (int)s->acquires,
+           (int)s->contended, (int)(s->spin / 10), (int)(s->max_hold / 10));
+  }
+}
+
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
@@ -95,3 +95,26 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// Contend for the benchmark lock of one kind; see lockbench().
+uint64
+sys_lockbench(void)
+{
+  int kind, n;
+
+  if(argint(0, &kind) < 0 || argint(1, &n) < 0)
+    return -1;
+  return lockbench(kind, n);
+}
+
+// Copy out up to n lock statistics entries; see lockstat_copyout().
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return lockstat_copyout(addr, n);
+}
@@ -50,7 +50,7 @@ cow_handle(pagetable_t pagetable, uint64 va)
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  initlock_kind(&tickslock, "time", LOCK_TICKET);
 }
 
 // set up to take exceptions and traps while in the kernel.
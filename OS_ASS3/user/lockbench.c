@@ -0,0 +1,63 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/spinlock.h"
+#include "user/user.h"
+
+// Spinlock contention benchmark. For each lock kind, starts NCPU
+// workers that all take and drop the same kernel lock in a loop,
+// then prints how long the run took and the longest any
+// worker waited for the lock. Compare kernels built with CPUS=3
+// and CPUS=8.
+//   lockbench [rounds]
+
+char *kinds[] = {
+[LOCK_TAS]    "tas",
+[LOCK_TICKET] "ticket",
+[LOCK_MCS]    "mcs",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 10000, fd[2], kind, i, waited, worst, start;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(rounds < 1 || pipe(fd) < 0){
+    fprintf(2, "usage: lockbench [rounds]\n");
+    exit(1);
+  }
+
+  for(kind = 0; kind < NLOCKKIND; kind++){
+    start = uptime();
+    for(i = 0; i < NCPU; i++){
+      int pid = fork();
+      if(pid < 0){
+        fprintf(2, "lockbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        waited = lockbench(kind, rounds);
+        write(fd[1], &waited, sizeof(waited));
+        exit(0);
+      }
+    }
+
+    worst = 0;
+    for(i = 0; i < NCPU; i++){
+      if(read(fd[0], &waited, sizeof(waited)) != sizeof(waited)){
+        fprintf(2, "lockbench: lost a worker's result\n");
+        exit(1);
+      }
+      if(waited > worst)
+        worst = waited;
+    }
+    while(wait(0) > 0)
+      ;
+    // the time CSR runs at 10MHz on qemu virt.
+    printf("%s: %d ticks, worst wait %d us\n", kinds[kind], uptime() - start,
+           worst / 10);
+  }
+  exit(0);
+}
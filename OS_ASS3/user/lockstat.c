@@ -0,0 +1,64 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/spinlock.h"
+#include "user/user.h"
+
+// Show lock contention statistics, most time spent waiting first.
+// Needs a kernel built with LOCKSTAT=ON.
+//   lockstat              counts since boot
+//   lockstat cmd args...  counts while cmd runs
+
+struct lockstat before[NLOCKCLASS], after[NLOCKCLASS];
+
+int
+main(int argc, char *argv[])
+{
+  int nbefore = 0, nafter, i, j, pid;
+  char done[NLOCKCLASS];
+
+  if(argc > 1){
+    if((nbefore = lockstat(before, NLOCKCLASS)) < 0){
+      fprintf(2, "lockstat: kernel built without LOCKSTAT=ON\n");
+      exit(1);
+    }
+    if((pid = fork()) < 0){
+      fprintf(2, "lockstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+  if((nafter = lockstat(after, NLOCKCLASS)) < 0){
+    fprintf(2, "lockstat: kernel built without LOCKSTAT=ON\n");
+    exit(1);
+  }
+
+  // entries keep their place, and new ones come at the end.
+  for(i = 0; i < nbefore; i++){
+    after[i].acquires -= before[i].acquires;
+    after[i].contended -= before[i].contended;
+    after[i].spin -= before[i].spin;
+  }
+
+  // the time CSR runs at 10MHz on qemu virt; hold is since boot.
+  printf("lock\tacquires\tcontended\tspin us\thold us\n");
+  memset(done, 0, sizeof(done));
+  for(i = 0; i < nafter; i++){
+    struct lockstat *s = 0;
+    for(j = 0; j < nafter; j++){
+      if(!done[j] && (s == 0 || after[j].spin > s->spin))
+        s = &after[j];
+    }
+    done[s - after] = 1;
+    if(s->acquires == 0)
+      continue;
+    printf("%s\t%d\t%d\t%d\t%d\n", s->name, (int)s->acquires,
+           (int)s->contended, (int)(s->spin / 10), (int)(s->max_hold / 10));
+  }
+  exit(0);
+}
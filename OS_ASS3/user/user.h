@@ -1,5 +1,6 @@
 struct stat;
 struct rtcdate;
+struct lockstat;
 
 // system calls
 int fork(void);
@@ -23,6 +24,8 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int lockbench(int, int);
+int lockstat(struct lockstat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);